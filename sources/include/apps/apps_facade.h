@@ -13,8 +13,42 @@ namespace ltsy {
 
     class AppsFacade {
 
+        private:
+            //> Counter-examples found for the rules checked on each matrix
+            mutable std::map<std::weak_ptr<GenMatrix>, std::shared_ptr<GenMatrixCounterExampleCache>,
+                std::owner_less<std::weak_ptr<GenMatrix>>> _counter_example_caches;
+            mutable std::mutex _caches_mutex;
+
+            /* Drop the caches of the matrices no longer alive,
+             * with the caches mutex held.
+             * */
+            void drop_expired_caches() const {
+                for (auto it = _counter_example_caches.begin(); it != _counter_example_caches.end(); )
+                    it = it->first.expired() ? _counter_example_caches.erase(it) : std::next(it);
+            }
+
         public:
 
+            /* The counter-examples found so far for the rules checked
+             * on a matrix, which are tried first on the next rules.
+             * */
+            std::shared_ptr<GenMatrixCounterExampleCache> counter_example_cache(std::shared_ptr<GenMatrix> matrix) const {
+                std::lock_guard<std::mutex> lock {_caches_mutex};
+                drop_expired_caches();
+                auto& cache = _counter_example_caches[matrix];
+                if (cache == nullptr)
+                    cache = std::make_shared<GenMatrixCounterExampleCache>();
+                return cache;
+            }
+
+            /* The number of matrices with counter-examples kept.
+             * */
+            std::size_t counter_example_caches() const {
+                std::lock_guard<std::mutex> lock {_caches_mutex};
+                drop_expired_caches();
+                return _counter_example_caches.size();
+            }
+
             std::pair<
                 std::optional<std::set<NDTruthTable>>,
                 std::optional<std::set<NDTruthTable>>>
@@ -91,6 +125,18 @@ namespace ltsy {
 
             /* App to check soundness of a rule wrt a given
              * generalized matrix.
+             *
+             * With more than one thread, the rules are checked 
+             * concurrently, each one by a share of the threads,
+             * and no progress is displayed.
+             *
+             * Every rule is checked even if others fail. The rules that
+             * failed are left out of the result; their errors are given
+             * in failures if present, otherwise the error of the first
+             * of them is thrown once all rules are checked.
+             *
+             * The counter-examples found are kept for the matrix, and
+             * tried first on the rules of the next calls.
              * */
             std::map<std::string, std::optional<std::vector<NdSequentGenMatrixValidator<std::set>::CounterExample>>>
             sequent_rule_soundness_check_gen_matrix(
@@ -98,14 +144,77 @@ namespace ltsy {
                     const std::vector<int>& sequent_set_correspondence,
                     const std::vector<NdSequentRule<std::set>>& rules, 
                     int max_counter_examples=1,
-                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt) const {
+                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt,
+                    int threads = 1,
+                    std::map<std::string, std::exception_ptr>* failures = nullptr) const {
                 NdSequentGenMatrixValidator<std::set> validator {matrix, sequent_set_correspondence}; 
+                auto cache = counter_example_cache(matrix);
+                std::vector<std::optional<std::vector<NdSequentGenMatrixValidator<std::set>::CounterExample>>>
+                    checked (rules.size());
+                std::vector<std::exception_ptr> errors (rules.size());
+                int rule_workers = std::min<int>(threads, rules.size());
+                auto check = [&](std::size_t i, std::optional<progresscpp::ProgressBar> rule_progress_bar, 
+                        int rule_threads) {
+                    try {
+                        checked[i] = validator.is_rule_satisfiability_preserving(rules[i], 
+                                rules[i].infer_signature(), max_counter_examples, rule_progress_bar, 
+                                rule_threads, cache.get());
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                };
+                if (rule_workers <= 1) {
+                    for (std::size_t i = 0; i < rules.size(); ++i)
+                        check(i, progress_bar, threads);
+                } else {
+                    std::atomic<std::size_t> next_rule {0};
+                    auto worker = [&]() {
+                        for (auto i = next_rule++; i < rules.size(); i = next_rule++)
+                            check(i, std::nullopt, threads / rule_workers);
+                    };
+                    std::vector<std::thread> workers;
+                    for (int t = 0; t < rule_workers; ++t)
+                        workers.emplace_back(worker);
+                    for (auto& w : workers)
+                        w.join();
+                }
                 std::map<std::string, std::optional<std::vector<NdSequentGenMatrixValidator<std::set>::CounterExample>>>
                     result;
-                for (const auto& r : rules) {
-                    Signature sig = r.infer_signature();
-                    result[r.name()] = validator.is_rule_satisfiability_preserving(r, sig, max_counter_examples, progress_bar);  
+                for (std::size_t i = 0; i < rules.size(); ++i) {
+                    if (not errors[i])
+                        result[rules[i].name()] = checked[i];
+                    else if (failures != nullptr)
+                        (*failures)[rules[i].name()] = errors[i];
                 }
+                if (failures == nullptr)
+                    for (const auto& error : errors)
+                        if (error)
+                            std::rethrow_exception(error);
+                return result;
+            }
+
+            /* App to test rules on random valuations of a given
+             * generalized matrix, for refuting them when there are 
+             * too many valuations to check.
+             *
+             * @param samples the number of valuations drawn for each rule
+             * @param seed the seed of the random generator
+             * */
+            std::map<std::string, NdSequentGenMatrixValidator<std::set>::SamplingResult>
+            sequent_rule_soundness_sample_gen_matrix(
+                    std::shared_ptr<GenMatrix> matrix,
+                    const std::vector<int>& sequent_set_correspondence,
+                    const std::vector<NdSequentRule<std::set>>& rules, 
+                    unsigned long long samples,
+                    std::uint64_t seed = 0,
+                    int max_counter_examples=1,
+                    double confidence = 0.95,
+                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt) const {
+                NdSequentGenMatrixValidator<std::set> validator {matrix, sequent_set_correspondence}; 
+                std::map<std::string, NdSequentGenMatrixValidator<std::set>::SamplingResult> result;
+                for (const auto& r : rules)
+                    result[r.name()] = validator.sample_counter_examples(r, r.infer_signature(), 
+                            samples, seed, max_counter_examples, confidence, progress_bar);
                 return result;
             }
 
@@ -79,10 +79,8 @@ namespace ltsy {
                std::set<NDTruthTable> projections;
                for (int i = 0; i < arity; ++i) {
                      NDTruthTable proj {_nvalues, arity, props[i]};
-                     for (auto det : proj.get_determinants()) {
-                         auto inputs = det.get_args();
-                         proj.set(det.get_args_pos(), {inputs[i]});
-                     }
+                     for (const auto& det : proj.determinants())
+                         proj.set(det.get_args_pos(), {det.get_args()[i]});
                      projections.insert(proj);
                }
                return projections;
@@ -102,46 +100,66 @@ namespace ltsy {
                 if (arity < 0) 
                     throw std::invalid_argument("negative arity in clone generation");
                 std::set<NDTruthTable> predicate_satisfied = {};
-                std::set<NDTruthTable> previous = {};
-                std::set<NDTruthTable> current = make_projections(arity, props);
+                std::set<NDTruthTable> initial = make_projections(arity, props);
                 for (auto b : _base)
                     if (b.arity() == arity)
-                        current.insert(b);
+                        initial.insert(b);
                 if (predicate) {
-                    for (const auto& c : current)
+                    for (const auto& c : initial)
                         if (predicate->first(c)) predicate_satisfied.insert(c);
                     if (predicate_satisfied.size() >= predicate->second)
                         return predicate_satisfied;
                 }
+                // the clone, as masked tables in the order they are found
+                TruthTableStore<ValueMask> current;
+                for (const auto& c : initial)
+                    current.insert(NDMaskTruthTable {c});
+                std::vector<NDMaskTruthTable> masked_base;
+                for (const auto& b : _base)
+                    masked_base.emplace_back(b);
+                NDMaskTableComposer composer;
+                NDMaskTruthTable composition;
+                std::vector<const NDMaskTruthTable*> gs;
+                std::size_t previous_size = 0;
                 int depth = 0;
-                while (previous != current) {
+                // the clone only grows, hence it is stable once its size is
+                while (previous_size != current.size()) {
                     depth += 1;
                     if (max_depth and depth > *max_depth)
                         break;
                     spdlog::info("Current size in clone generation: " + std::to_string(current.size()));
-                    previous = current;
-                    for (const auto& b : _base) {
+                    previous_size = current.size();
+                    for (const auto& b : masked_base) {
                         auto arity_base = b.arity();
-                        InputFunctionsGenerator gen {arity_base, current};
-                        while (gen.has_next()) {
-                            auto gs = gen.next();
+                        if (arity_base == 0)
+                            continue;
+                        // tuples of the tables found so far, lexicographically
+                        gs.resize(arity_base);
+                        for (utils::RowCursor tuple {int(current.size()), arity_base}; not tuple.done(); tuple.next()) {
+                            for (int j = 0; j < arity_base; ++j)
+                                gs[j] = &current[tuple[j]];
                             try {
-                                auto composition = b.compose(gs);
-                                if (predicate) {
-                                    if (predicate->first(composition)) {
-                                        predicate_satisfied.insert(composition);
-                                        if (predicate_satisfied.size() >= predicate->second)
-                                            return predicate_satisfied;
-                                    }
+                                composer.compose(b, gs, composition);
+                            } catch(std::invalid_argument){ continue; }
+                            if (not current.insert(composition))
+                                continue;
+                            if (predicate) {
+                                auto table = composition.to_set_table();
+                                if (predicate->first(table)) {
+                                    predicate_satisfied.insert(table);
+                                    if (predicate_satisfied.size() >= predicate->second)
+                                        return predicate_satisfied;
                                 }
-                                current.insert(composition);
-                            } catch(std::invalid_argument){}
+                            }
                         }
                     }
                 }
                 if (predicate)
                     return predicate_satisfied;
-                return current;
+                std::set<NDTruthTable> result;
+                for (const auto& c : current)
+                    result.insert(c.to_set_table());
+                return result;
             }
     
     };
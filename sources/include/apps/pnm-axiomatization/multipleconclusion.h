@@ -295,7 +295,35 @@ namespace ltsy {
                 return result;
             }
 
+            /* Keep a single rule among those differing only by
+             * a renaming of variables, the least one.
+             *
+             * @param canonicals if given, the canonical forms of the rules
+             * already met, completed with those of the new rules, so that
+             * repeated calls canonicalize each rule once
+             * */
+            void remove_renamings(std::set<MultipleConclusionRule>& rules,
+                    std::map<MultipleConclusionRule, NdSequent<std::set>>* canonicals = nullptr) {
+                std::unordered_map<std::size_t, std::vector<NdSequent<std::set>>> seen;
+                std::map<MultipleConclusionRule, NdSequent<std::set>> local;
+                auto& known = canonicals != nullptr ? *canonicals : local;
+                for (auto it = rules.begin(); it != rules.end();) {
+                    auto found = known.find(*it);
+                    if (found == known.end())
+                        found = known.insert({*it, it->sequent().canonical()}).first;
+                    const auto& canonical = found->second;
+                    auto& bucket = seen[canonical.hash()];
+                    if (std::find(bucket.begin(), bucket.end(), canonical) != bucket.end())
+                        it = rules.erase(it);
+                    else {
+                        bucket.push_back(canonical);
+                        ++it;
+                    }
+                }
+            }
+
             void remove_dilutions(std::set<MultipleConclusionRule>& rules) {
+                remove_renamings(rules);
                 spdlog::debug("Removing dilutions (size " + std::to_string(rules.size()) + ")...");
                 auto it = rules.begin();
                 int round = 1;
@@ -395,8 +423,11 @@ namespace ltsy {
                 spdlog::debug("Simplifying by cuts...");
                 std::set<MultipleConclusionRule> previous = {};
                 std::set<MultipleConclusionRule> current = rules;
+                // canonical forms kept across the rounds, only new rules being canonicalized
+                std::map<MultipleConclusionRule, NdSequent<std::set>> canonicals;
+                remove_renamings(current, &canonicals);
                 std::set<MultipleConclusionRule> prev_newrules = {};
-                std::set<MultipleConclusionRule> newrules = cuts_between_sets(rules, rules);
+                std::set<MultipleConclusionRule> newrules = cuts_between_sets(current, current);
                 int round = 0;
                 while (current != previous) {
                     // update progress
@@ -405,6 +436,7 @@ namespace ltsy {
                     previous = current;
                     prev_newrules = newrules;
                     current.insert(newrules.begin(), newrules.end());
+                    remove_renamings(current, &canonicals);
                     newrules = cuts_between_sets(current, prev_newrules); 
                 }
                 return current;
@@ -526,9 +558,9 @@ namespace ltsy {
                 auto props = make_props(arity);
                 auto compound = make_compound(connective, props);
                 // loop over the determinants
-                for (auto determinant : truth_table->get_determinants()) {
-                    auto args = determinant.get_args(); 
-                    auto response = determinant.get_last();
+                for (const auto& determinant : truth_table->determinants()) {
+                    const auto& args = determinant.get_args(); 
+                    const auto& response = determinant.get_last();
                     auto response_complement = utils::set_difference(values, response);
                     for (auto y : response_complement) {
                          std::vector<FmlaSet> sequent {dsets.size()};
@@ -554,6 +586,7 @@ namespace ltsy {
                          result.insert(mcrule);
                     }
                 } 
+                remove_renamings(result);
                 return result;
             }
 
@@ -570,9 +603,9 @@ namespace ltsy {
                 auto props = make_props(arity);
                 auto compound = make_compound(connective, props);
                 // loop over the determinants
-                for (auto determinant : truth_table->get_determinants()) {
-                    auto args = determinant.get_args(); 
-                    auto response = determinant.get_last();
+                for (const auto& determinant : truth_table->determinants()) {
+                    const auto& args = determinant.get_args(); 
+                    const auto& response = determinant.get_last();
                     //auto response_complement = utils::set_difference(values, response);
                     for (auto y : response) {
                          std::vector<FmlaSet> sequent {dsets.size()};
@@ -2,6 +2,7 @@
 #define __CLI_HANDLERS__
 
 #include <iostream>
+#include <sstream>
 #include "yaml/yamlcpp_parser.h"
 #include "spdlog/spdlog.h"
 #include "tt_determination/ndsequents.h"
@@ -1083,6 +1084,10 @@ namespace ltsy {
             const std::string INFER_COMPLEMENTS_TITLE = "infer_complements";
             const std::string SEQUENT_DSET_CORRESPOND_TITLE = "sequent_dset_correspondence";
             const std::string MAX_COUNTER_MODELS_TITLE = "max_counter_models";
+            const std::string THREADS_TITLE = "threads";
+            const std::string SAMPLES_TITLE = "samples";
+            const std::string SEED_TITLE = "seed";
+            const std::string CONFIDENCE_TITLE = "confidence";
 
         public:
             void handle(const std::string& yaml_path) {
@@ -1100,24 +1105,84 @@ namespace ltsy {
                     int max_counter_models = parser.hard_require(root, MAX_COUNTER_MODELS_TITLE).as<int>();
                     auto seq_dset_corr = parser.hard_require(root, SEQUENT_DSET_CORRESPOND_TITLE)
                         .as<std::vector<int>>();
+                    int threads = parser.optional_require<int>(root, THREADS_TITLE, 1).value();
                     AppsFacade apps_facade;
-                    for (const auto& rule : rules) {
-                        spdlog::info("Checking for rule " + rule.name() + "...");
-                        try {
-                            auto soundness_results = apps_facade.sequent_rule_soundness_check_gen_matrix(
-                                        pnmatrix, seq_dset_corr, {rule}, max_counter_models,
-                                        std::make_optional<progresscpp::ProgressBar>(70)
-                                    );
-                            auto result = soundness_results[rule.name()];
-                            if (not result) {
-                                spdlog::info("Sound.");
-                            } else {
-                                spdlog::info("Not sound. Consider the following configuration(s):");
-                                for (const auto& ce : *result) {
-                                    spdlog::info("\n" + ce.val.print(pnmatrix->val_to_str()).str());
+                    auto print_counter_examples = [&](const auto& counter_examples) {
+                        for (const auto& ce : counter_examples)
+                            spdlog::info("\n" + ce.val.print(pnmatrix->val_to_str()).str());
+                    };
+                    if (auto samples = parser.optional_require<unsigned long long>(root, SAMPLES_TITLE, std::nullopt)) {
+                        // sampling mode: refute rules on random valuations
+                        auto seed = parser.optional_require<std::uint64_t>(root, SEED_TITLE, 0).value();
+                        auto confidence = parser.optional_require<double>(root, CONFIDENCE_TITLE, 0.95).value();
+                        for (const auto& rule : rules) {
+                            spdlog::info("Sampling " + std::to_string(*samples) + " valuations for rule " 
+                                    + rule.name() + "...");
+                            try {
+                                auto sampling_results = apps_facade.sequent_rule_soundness_sample_gen_matrix(
+                                            pnmatrix, seq_dset_corr, {rule}, *samples, seed, max_counter_models,
+                                            confidence, std::make_optional<progresscpp::ProgressBar>(70));
+                                const auto& result = sampling_results[rule.name()];
+                                if (result.counter_examples.empty()) {
+                                    std::stringstream ss;
+                                    ss << "Not refuted in " << result.samples << " samples. With confidence " 
+                                       << result.confidence << ", at most a fraction " 
+                                       << result.max_counter_example_rate.value_or(1) 
+                                       << " of the valuations are counter-examples.";
+                                    spdlog::info(ss.str());
+                                } else {
+                                    spdlog::info("Not sound (refuted in " + std::to_string(result.samples) 
+                                            + " samples). Consider the following configuration(s):");
+                                    print_counter_examples(result.counter_examples);
+                                }
+                            } catch (const std::exception& e) {
+                                spdlog::error(e.what());
+                            }
+                        }
+                        return;
+                    }
+                    auto report = [&](const NdSequentRule<std::set>& rule, 
+                            const std::optional<std::vector<NdSequentGenMatrixValidator<std::set>::CounterExample>>& result) {
+                        if (not result) {
+                            spdlog::info("Sound.");
+                        } else {
+                            spdlog::info("Not sound. Consider the following configuration(s):");
+                            print_counter_examples(*result);
+                        }
+                    };
+                    if (threads > 1 and rules.size() > 1) {
+                        // check the rules concurrently, then report them in order
+                        spdlog::info("Checking " + std::to_string(rules.size()) + " rules with " 
+                                + std::to_string(threads) + " threads...");
+                        std::map<std::string, std::exception_ptr> failures;
+                        auto soundness_results = apps_facade.sequent_rule_soundness_check_gen_matrix(
+                                    pnmatrix, seq_dset_corr, rules, max_counter_models, std::nullopt, threads,
+                                    &failures);
+                        for (const auto& rule : rules) {
+                            spdlog::info("Rule " + rule.name() + ":");
+                            if (auto failure = failures.find(rule.name()); failure != failures.end()) {
+                                try {
+                                    std::rethrow_exception(failure->second);
+                                } catch (const std::exception& e) {
+                                    spdlog::error(e.what());
                                 }
+                            } else {
+                                report(rule, soundness_results[rule.name()]);
+                            }
+                        }
+                    } else {
+                        for (const auto& rule : rules) {
+                            spdlog::info("Checking for rule " + rule.name() + "...");
+                            try {
+                                auto soundness_results = apps_facade.sequent_rule_soundness_check_gen_matrix(
+                                            pnmatrix, seq_dset_corr, {rule}, max_counter_models,
+                                            std::make_optional<progresscpp::ProgressBar>(70), threads
+                                        );
+                                report(rule, soundness_results[rule.name()]);
+                            } catch (const std::exception& e) {
+                                spdlog::error(e.what());
                             }
-                        } catch(std::exception e) {}
+                        }
                     }
                 } catch (ParseException& pe) {
                     spdlog::critical(pe.message());
@@ -0,0 +1,44 @@
+#ifndef __PERMUTATIONS__
+#define __PERMUTATIONS__
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace ltsy {
+
+    /* The permutations of the values {0,...,n-1}, each given
+     * by the vector of the images of the values, in
+     * lexicographical order.
+     *
+     * @param n the number of values
+     * @param preserved if present, only the permutations
+     *        mapping this set onto itself are given
+     * @param include_identity if the identity must be given
+     * @return the permutations
+     * */
+    inline std::vector<std::vector<int>> value_permutations(int n,
+            const std::optional<std::set<int>>& preserved = std::nullopt,
+            bool include_identity = false) {
+        std::vector<std::vector<int>> result;
+        std::vector<int> sigma (n);
+        std::iota(sigma.begin(), sigma.end(), 0);
+        do {
+            bool identity = std::is_sorted(sigma.begin(), sigma.end());
+            if (identity and not include_identity)
+                continue;
+            bool preserves = true;
+            if (preserved)
+                for (auto v : *preserved)
+                    preserves = preserves and preserved->count(sigma[v]) > 0;
+            if (preserves)
+                result.push_back(sigma);
+        } while (std::next_permutation(sigma.begin(), sigma.end()));
+        return result;
+    }
+
+};
+
+#endif
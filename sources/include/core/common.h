@@ -12,6 +12,7 @@
 
 namespace ltsy {
     using Symbol = std::string;
+    using SymbolId = std::size_t;
     using Arity = int;
 
     using PrimKeyType = std::variant<char, int, std::string>;
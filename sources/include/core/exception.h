@@ -15,6 +15,8 @@ namespace ltsy{
     const std::string INVALID_TRUTH_VALUE_EXCEPTION = "invalid truth-value";
     const std::string NULL_IN_CONNECTIVE_INTERP_EXCEPTION = "null value in connective interpretation";
     const std::string CONNECTIVE_ALREADY_INTERP_EXCEPTION = "connective already interpreted";
+    const std::string TOO_MANY_FUNCTIONS_EXCEPTION = "number of functions exceeds the 64-bit index range";
+    const std::string WRONG_TABLE_INDEX_EXCEPTION = "invalid truth-table index";
 
 
     class ConnectiveNotPresentException : public std::exception {
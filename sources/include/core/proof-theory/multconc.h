@@ -3,6 +3,7 @@
 
 #include "ndsequents.h"
 #include <numeric>
+#include <optional>
 #include <memory>
 #include "core/combinatorics/combinations.h"
 
@@ -103,16 +104,35 @@ namespace ltsy {
             std::vector<FmlaSet> premises() const { return _premises; }
             std::vector<FmlaSet> conclusions() const { return _conclusions; }
 
-            MultipleConclusionRule apply_substitution(const FormulaVarAssignment& ass) const {
-                auto new_seq = _sequent.apply_substitution(ass);
+            MultipleConclusionRule apply_substitution(const FormulaVarAssignment& ass,
+                    std::shared_ptr<FormulaFactory> factory = nullptr) const {
+                auto new_seq = _sequent.apply_substitution(ass, factory);
                 auto assptr = std::make_shared<FormulaVarAssignment>(ass);
                 MultipleConclusionRule r {_name, new_seq, _prem_conc_pos_corresp, assptr}; 
                 return r;
             }
 
+            /* The rule with its variables renamed into a normal
+             * order (see NdSequent::canonical).
+             * */
+            MultipleConclusionRule canonical() const {
+                MultipleConclusionRule result {*this};
+                result._sequent = _sequent.canonical();
+                return result;
+            }
+
+            inline std::size_t canonical_hash() const { return _sequent.canonical_hash(); }
+
+            inline bool is_renaming_of(const MultipleConclusionRule& other) const {
+                return _sequent.is_renaming_of(other._sequent);
+            }
+
             bool has_only(const FmlaSet& fmlas) const {
-                auto rule_fmlas = _sequent.collect_fmlas();
-                return is_subset(rule_fmlas, fmlas); 
+                for (int i = 0; i < _sequent.dimension(); ++i)
+                    for (const auto& f : _sequent.at(i))
+                        if (fmlas.find(f) == fmlas.end())
+                            return false;
+                return true;
             }
 
             MultipleConclusionRule transform(const std::vector<std::pair<int, int>>& transformation,
@@ -124,6 +144,147 @@ namespace ltsy {
     };
 
 
+    /* A rule compiled for instantiation. Its formulas are
+     * flattened into a formula pool, whose variables are the
+     * slots filled by an assignment, and instances are computed
+     * bottom-up over the pool.
+     *
+     * Instances may also be resolved against a formula factory,
+     * without creating anything: if every instance formula
+     * already has a node in the factory, the nodes (and their ids)
+     * can be inspected before the instance rule is built.
+     *
+     * @author Vitor Greati
+     * */
+    class MultipleConclusionRuleTemplate {
+
+        public:
+
+            using Nodes = std::vector<std::shared_ptr<Formula>>;
+
+        private:
+
+            MultipleConclusionRule _rule;
+            FormulaPool _pool;
+            Nodes _originals; //> The rule subformula represented by each pool node
+            std::vector<std::vector<std::size_t>> _positions; //> Pool nodes in each sequent position
+
+            std::size_t compile(const std::shared_ptr<Formula>& fmla) {
+                auto index = _pool.add(fmla);
+                if (_originals.size() < _pool.size())
+                    _originals.resize(_pool.size());
+                if (_originals[index] == nullptr) {
+                    _originals[index] = fmla;
+                    if (fmla->type() == Formula::FmlaType::COMPOUND)
+                        for (const auto& c : std::static_pointer_cast<Compound>(fmla)->components())
+                            compile(c);
+                }
+                return index;
+            }
+
+            MultipleConclusionRule build(const Nodes& nodes, const FormulaVarAssignment& ass) const {
+                NdSequent<std::set> sequent {_positions.size()};
+                for (int i = 0; i < _positions.size(); ++i)
+                    for (auto n : _positions[i])
+                        sequent[i].insert(nodes[n]);
+                return MultipleConclusionRule {_rule.name(), sequent, _rule.prem_conc_pos_corresp(),
+                    std::make_shared<FormulaVarAssignment>(ass)};
+            }
+
+        public:
+
+            explicit MultipleConclusionRuleTemplate(const MultipleConclusionRule& rule) : _rule {rule} {
+                auto sequent = rule.sequent();
+                _positions.resize(sequent.dimension());
+                for (int i = 0; i < sequent.dimension(); ++i)
+                    for (const auto& f : sequent.at(i))
+                        _positions[i].push_back(compile(f));
+            }
+
+            inline const MultipleConclusionRule& rule() const { return _rule; }
+
+            inline int dimension() const { return _positions.size(); }
+
+            /* Pool nodes of the formulas in a sequent position.
+             * */
+            inline const std::vector<std::size_t>& position(int i) const { return _positions[i]; }
+
+            /* Resolve the nodes of an instance in a factory.
+             *
+             * @param nodes filled with the node of each pool index
+             * @return false if some instance formula has no node in the factory
+             * */
+            bool resolve(const FormulaVarAssignment& ass, const FormulaFactory& factory, Nodes& nodes) const {
+                nodes.resize(_pool.size());
+                std::vector<std::size_t> component_ids;
+                for (std::size_t i = 0; i < _pool.size(); ++i) {
+                    const auto& node = _pool.node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        auto fmla = ass(_pool.variables()[node.symbol].symbol_id());
+                        nodes[i] = factory.find(fmla ? fmla : _originals[i]);
+                    } else {
+                        component_ids.resize(node.arity);
+                        for (std::size_t k = 0; k < node.arity; ++k)
+                            component_ids[k] = nodes[_pool.child(i, k)]->id();
+                        const auto& connective = _pool.connectives()[node.symbol];
+                        nodes[i] = factory.find_compound(connective->symbol_id(), 
+                                connective->arity(), component_ids);
+                    }
+                    if (nodes[i] == nullptr)
+                        return false;
+                }
+                return true;
+            }
+
+            /* Build the instance whose nodes were resolved by resolve.
+             * */
+            MultipleConclusionRule instantiate(const Nodes& nodes, const FormulaVarAssignment& ass) const {
+                return build(nodes, ass);
+            }
+
+            /* Build the instance of the rule by an assignment, the same
+             * as MultipleConclusionRule::apply_substitution.
+             * */
+            MultipleConclusionRule instantiate(const FormulaVarAssignment& ass, 
+                    std::shared_ptr<FormulaFactory> factory = nullptr) const {
+                Nodes nodes (_pool.size());
+                for (std::size_t i = 0; i < _pool.size(); ++i) {
+                    const auto& node = _pool.node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        auto fmla = ass(_pool.variables()[node.symbol].symbol_id());
+                        nodes[i] = fmla ? fmla : _originals[i];
+                        if (factory)
+                            nodes[i] = factory->intern(nodes[i]);
+                        continue;
+                    }
+                    auto original = std::static_pointer_cast<Compound>(_originals[i]);
+                    bool unchanged = true;
+                    Nodes components (node.arity);
+                    for (std::size_t k = 0; k < node.arity; ++k) {
+                        components[k] = nodes[_pool.child(i, k)];
+                        unchanged &= components[k] == original->components()[k];
+                    }
+                    if (factory)
+                        nodes[i] = factory->make_compound(original->connective(), components);
+                    else
+                        nodes[i] = unchanged ? _originals[i] 
+                            : std::make_shared<Compound>(original->connective(), components);
+                }
+                return build(nodes, ass);
+            }
+
+            /* Build the instances of the rule by a batch of assignments.
+             * */
+            std::vector<MultipleConclusionRule> instantiate(const std::vector<FormulaVarAssignment>& batch,
+                    std::shared_ptr<FormulaFactory> factory = nullptr) const {
+                std::vector<MultipleConclusionRule> instances;
+                instances.reserve(batch.size());
+                for (const auto& ass : batch)
+                    instances.push_back(instantiate(ass, factory));
+                return instances;
+            }
+    };
+
     /* Generate all subrules of a given rule.
      * */
     class MultipleConclusionSubrulesGenerator {
@@ -207,10 +368,13 @@ namespace ltsy {
         protected:
             std::vector<MultipleConclusionRule> _rules;
             FmlaSet _fmlas_to_make_instances;
+            std::shared_ptr<FormulaFactory> _fmla_factory; //> If given, instances are interned in it
         public:
             MCProofSearchHeuristics(const decltype(_rules)& rules,
-                    const decltype(_fmlas_to_make_instances)& fmlas_to_make_instances)
-                : _rules {rules}, _fmlas_to_make_instances {fmlas_to_make_instances} {}
+                    const decltype(_fmlas_to_make_instances)& fmlas_to_make_instances,
+                    decltype(_fmla_factory) fmla_factory = nullptr)
+                : _rules {rules}, _fmlas_to_make_instances {fmlas_to_make_instances},
+                _fmla_factory {fmla_factory} {}
             virtual ~MCProofSearchHeuristics() {};
             virtual MultipleConclusionRule select_instance() = 0;
             virtual bool has_next() = 0;
@@ -224,18 +388,51 @@ namespace ltsy {
      * @author Vitor Greati
      * */
     class MCProofSearchSequentialHeuristics : public MCProofSearchHeuristics {
+        public:
+            using InstanceTest = std::function<bool(const MultipleConclusionRuleTemplate&,
+                    const MultipleConclusionRuleTemplate::Nodes&)>;
         private:
             decltype(_rules)::iterator _rules_it;
             FormulaVarAssignmentGenerator _current_subst_generator;
+            std::vector<std::optional<MultipleConclusionRuleTemplate>> _templates; //> Compiled when first reached
             bool finished = false;
+
+            const MultipleConclusionRuleTemplate& current_template() {
+                auto& tmpl = _templates[std::distance(_rules.begin(), _rules_it)];
+                if (not tmpl)
+                    tmpl.emplace(*_rules_it);
+                return *tmpl;
+            }
+
+            /* Advance to the next candidate instance, returning its
+             * assignment (nullptr if the current rule has none to
+             * be instantiated with).
+             * */
+            std::shared_ptr<FormulaVarAssignment> next_candidate() {
+                if (std::next(_rules_it) != _rules.end() and not _current_subst_generator.has_next()) {
+                    ++_rules_it;
+                    auto rule_props = _rules_it->sequent().collect_props();
+                    _current_subst_generator = FormulaVarAssignmentGenerator 
+                                                    {rule_props, _fmlas_to_make_instances};
+                }
+                std::shared_ptr<FormulaVarAssignment> ass = nullptr;
+                if (_current_subst_generator.has_next())
+                    ass = _current_subst_generator.next();
+                if (std::next(_rules_it) == _rules.end() and not _current_subst_generator.has_next())
+                    finished = true;
+                return ass;
+            }
         public:
             MCProofSearchSequentialHeuristics(const decltype(_rules)& rules,
-                    const decltype(_fmlas_to_make_instances)& fmlas_to_make_instances)
-                : MCProofSearchHeuristics {rules, fmlas_to_make_instances} {
+                    const decltype(_fmlas_to_make_instances)& fmlas_to_make_instances,
+                    decltype(_fmla_factory) fmla_factory = nullptr)
+                : MCProofSearchHeuristics {rules, fmlas_to_make_instances, fmla_factory} {
                     init();
             }
 
             void init() {
+                _templates.clear();
+                _templates.resize(_rules.size());
                 if (_rules.empty())
                     finished = true;
                 else {
@@ -250,28 +447,34 @@ namespace ltsy {
 
             MultipleConclusionRule select_instance() {
                 if (has_next()) {
-                    if (std::next(_rules_it) != _rules.end() and not _current_subst_generator.has_next()) {
-                        auto rule = *(++_rules_it);
-                        auto rule_props = rule.sequent().collect_props();
-                        _current_subst_generator = FormulaVarAssignmentGenerator 
-                                                        {rule_props, _fmlas_to_make_instances};
-                    }
-                    auto rule = *(_rules_it);
-                    if (_current_subst_generator.has_next()) {
-                        auto ass = _current_subst_generator.next();
-                        // apply it to the rule
-                        auto rule_instance = rule.apply_substitution(*ass);
-                        if (std::next(_rules_it) == _rules.end() and not _current_subst_generator.has_next())
-                            finished = true;
-                        return rule_instance;
-                    } else {
-                        if (std::next(_rules_it) == _rules.end() and not _current_subst_generator.has_next())
-                            finished = true;
-                        return rule;
-                    }
+                    auto ass = next_candidate();
+                    if (ass == nullptr)
+                        return *_rules_it;
+                    return current_template().instantiate(*ass, _fmla_factory);
                 }
                 throw std::logic_error("there is no next rule instance");
             }
+
+            /* Select the next instance passing a test, which is run on the
+             * instance nodes resolved in the formula factory, before building it.
+             * Instances having formulas without a node in the factory are skipped.
+             *
+             * @return the instance, or nullopt if no remaining instance passes the test
+             * */
+            std::optional<MultipleConclusionRule> select_instance(const InstanceTest& test) {
+                if (_fmla_factory == nullptr)
+                    throw std::logic_error("selecting instances by test requires a formula factory");
+                MultipleConclusionRuleTemplate::Nodes nodes;
+                FormulaVarAssignment empty;
+                while (has_next()) {
+                    auto ass = next_candidate();
+                    const auto& tmpl = current_template();
+                    const auto& assignment = ass ? *ass : empty;
+                    if (tmpl.resolve(assignment, *_fmla_factory, nodes) and test(tmpl, nodes))
+                        return ass ? tmpl.instantiate(nodes, assignment) : *_rules_it;
+                }
+                return std::nullopt;
+            }
             bool has_next() {
                 return not finished;
                 //return (std::next(_rules_it) != _rules.end()) or 
@@ -287,8 +490,9 @@ namespace ltsy {
     class MCProofSearchRandSequentialHeuristics : public MCProofSearchSequentialHeuristics {
         public:
             MCProofSearchRandSequentialHeuristics(const decltype(_rules)& rules,
-                    const decltype(_fmlas_to_make_instances)& fmlas_to_make_instances)
-                : MCProofSearchSequentialHeuristics {rules, fmlas_to_make_instances} {
+                    const decltype(_fmlas_to_make_instances)& fmlas_to_make_instances,
+                    decltype(_fmla_factory) fmla_factory = nullptr)
+                : MCProofSearchSequentialHeuristics {rules, fmlas_to_make_instances, fmla_factory} {
                 // shuffle
                 std::random_shuffle(_rules.begin(), _rules.end());
                 init();
@@ -398,6 +602,7 @@ namespace ltsy {
 
             std::vector<MultipleConclusionRule> _rules;
             unsigned int _analiticity_level = 1;
+            std::shared_ptr<FormulaFactory> _fmla_factory; //> Interns the formulas of the current derivation
 	    std::optional<MultipleConclusionRule> _empty_rule = std::nullopt;
 
             void print_set(const FmlaSet& f) const {
@@ -431,34 +636,88 @@ namespace ltsy {
                     auto rules = _rules;
                     // create the heuristics
                     auto heuristics = std::make_shared<MCProofSearchRandSequentialHeuristics>(rules,
-                            fmlas_to_make_instances);
+                            fmlas_to_make_instances, _fmla_factory);
+                    // hash the node formulas once, they are probed by every instance
+                    std::vector<FmlaHashSet> node_fmlas_index;
+                    node_fmlas_index.reserve(node_fmlas.size());
+                    for (const auto& fmlas : node_fmlas)
+                        node_fmlas_index.emplace_back(fmlas.begin(), fmlas.end());
+                    // when every formula involved is interned, instances are
+                    // tested by node ids before being built
+                    auto owned = [&](const FmlaSet& fmlas) {
+                        return std::all_of(fmlas.begin(), fmlas.end(),
+                                [&](const auto& f) { return _fmla_factory->owns(*f); });
+                    };
+                    bool test_by_ids = _fmla_factory != nullptr and owned(fmlas_allowed_in_derivations)
+                        and std::all_of(node_fmlas.begin(), node_fmlas.end(), owned);
+                    std::unordered_set<std::size_t> allowed_ids;
+                    std::vector<std::unordered_set<std::size_t>> node_ids (node_fmlas.size());
+                    if (test_by_ids) {
+                        for (const auto& f : fmlas_allowed_in_derivations)
+                            allowed_ids.insert(f->id());
+                        for (auto i {0}; i < node_fmlas.size(); ++i)
+                            for (const auto& f : node_fmlas[i])
+                                node_ids[i].insert(f->id());
+                    }
+                    auto instance_test = [&](const MultipleConclusionRuleTemplate& tmpl,
+                            const MultipleConclusionRuleTemplate::Nodes& nodes) {
+                        // validate for analiticity
+                        for (auto pos {0}; pos < tmpl.dimension(); ++pos)
+                            for (auto n : tmpl.position(pos))
+                                if (allowed_ids.count(nodes[n]->id()) == 0)
+                                    return false;
+                        // conclusions must not intersect the node formulas, and
+                        // premises must be included in them
+                        const auto& corresp = tmpl.rule().prem_conc_pos_corresp();
+                        for (auto i {0}; i < corresp.size(); ++i) {
+                            const auto& [p, c] = corresp[i];
+                            for (auto n : tmpl.position(c))
+                                if (node_ids[i].count(nodes[n]->id()) != 0)
+                                    return false;
+                            for (auto n : tmpl.position(p))
+                                if (node_ids[i].count(nodes[n]->id()) == 0)
+                                    return false;
+                        }
+                        return true;
+                    };
                     bool some_premiss_satisfied = false;
                     while (heuristics->has_next()) {
                        bool useful_instance = true;
                        some_premiss_satisfied = false;
                        satisfied = false;
                        // obtain an instance
-                       auto rule_instance = heuristics->select_instance();
-                       // validate for analiticity
-                       if (not rule_instance.has_only(fmlas_allowed_in_derivations))
-                           continue;
-                       auto rule_conclusions = rule_instance.conclusions();
-                       // check node fmlas conclusion intersection
-                       bool conclusion_intersect_node_fmlas = false;
-                       for (auto i {0}; i < rule_conclusions.size(); ++i) {
-                            FmlaSet inters = intersection(node_fmlas[i], rule_conclusions[i]);
-                            if (not inters.empty()) { 
-                                conclusion_intersect_node_fmlas = true;
-                                break;
-                            }
-                       }
-                       if (conclusion_intersect_node_fmlas)
-                           continue;
-                       // check if premises subseteq node_fmlas
-                       const auto& premises = rule_instance.premises();
+                       std::optional<MultipleConclusionRule> selected;
                        bool premises_satisfied = true;
-                       for (auto i {0}; i < node_fmlas.size(); ++i)
-                           premises_satisfied &= is_subset(premises[i], node_fmlas[i]);
+                       if (test_by_ids) {
+                           selected = heuristics->select_instance(instance_test);
+                           if (not selected)
+                               break;
+                       } else {
+                           selected = heuristics->select_instance();
+                           // validate for analiticity
+                           if (not selected->has_only(fmlas_allowed_in_derivations))
+                               continue;
+                           auto rule_conclusions = selected->conclusions();
+                           // check node fmlas conclusion intersection
+                           bool conclusion_intersect_node_fmlas = false;
+                           for (auto i {0}; i < rule_conclusions.size(); ++i) {
+                                for (const auto& c : rule_conclusions[i])
+                                    if (node_fmlas_index[i].find(c) != node_fmlas_index[i].end()) {
+                                        conclusion_intersect_node_fmlas = true;
+                                        break;
+                                    }
+                                if (conclusion_intersect_node_fmlas)
+                                    break;
+                           }
+                           if (conclusion_intersect_node_fmlas)
+                               continue;
+                           // check if premises subseteq node_fmlas
+                           const auto& premises = selected->premises();
+                           for (auto i {0}; i < node_fmlas.size() and premises_satisfied; ++i)
+                               premises_satisfied = is_subset(premises[i], node_fmlas_index[i]);
+                       }
+                       const auto& rule_instance = *selected;
+                       auto rule_conclusions = rule_instance.conclusions();
                        if (premises_satisfied) {
                            if (rule_instance.all_conclusions_empty()) {
                                auto star_node = 
@@ -523,7 +782,7 @@ namespace ltsy {
                     for (auto f : statement_fmlas) {
                         SubFormulaCollector collector;
                         f->accept(collector);
-                        auto s = collector.subfmlas(); 
+                        auto s = _fmla_factory->intern(collector.subfmlas()); 
                         statement_subfmlas.insert(s.begin(), s.end());
                     }
                     return {{}, statement_subfmlas};
@@ -532,14 +791,12 @@ namespace ltsy {
                 FmlaSet gen_sb_phi = S2; // S_{k-1} cup...
                 // compute \Sb_\phi by all substitutions over \phi using formulas in \Sb
                 FormulaVarAssignmentGenerator gen_sb_phi_subs {props_phi, S2}; // props_phi -> S2
-                for (auto fm : phi) {
-                    while(gen_sb_phi_subs.has_next()) {
-                        auto s = gen_sb_phi_subs.next();
-                        SubstitutionEvaluator eval {*s};
-                        auto fmsubs = fm->accept(eval);
-                        gen_sb_phi.insert(fmsubs);
-                    }
-                    gen_sb_phi_subs.reset();
+                while(gen_sb_phi_subs.has_next()) {
+                    auto s = gen_sb_phi_subs.next();
+                    // one evaluator per assignment, shared by the formulas in phi
+                    SubstitutionEvaluator eval {*s, _fmla_factory};
+                    for (auto fm : phi)
+                        gen_sb_phi.insert(fm->accept(eval));
                 }
                 return {S2, gen_sb_phi};
             }
@@ -617,6 +874,8 @@ namespace ltsy {
 		    closed_derivation->closed = true;
 	 	    return closed_derivation;
 		}
+                // structurally equal formulas of this derivation share a node
+                _fmla_factory = std::make_shared<FormulaFactory>();
                 // get the props in phi
                 PropSet props_phi;
                 for (auto f : phi) {
@@ -631,8 +890,8 @@ namespace ltsy {
                 std::vector<FmlaSet> premises;
                 std::vector<FmlaSet> conclusions;
                 for (const auto& [p,c] : statement.prem_conc_pos_corresp()) {
-                    premises.push_back(statement.sequent()[p]);   
-                    conclusions.push_back(statement.sequent()[c]);   
+                    premises.push_back(_fmla_factory->intern(statement.sequent()[p]));   
+                    conclusions.push_back(_fmla_factory->intern(statement.sequent()[c]));   
                 }
                 // search for the derivation
                 auto derivation = std::make_shared<DerivationTreeNode>(premises, 
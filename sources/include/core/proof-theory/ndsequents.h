@@ -4,6 +4,7 @@
 #include <vector>
 #include <set>
 #include <unordered_set>
+#include <optional>
 #include "core/syntax.h"
 
 namespace ltsy {
@@ -18,6 +19,60 @@ namespace ltsy {
             std::vector<FmlaContainerT<std::shared_ptr<Formula>, utils::DeepSharedPointerComp<Formula>>> _sequent_fmlas;
             size_t _dimension;
 
+            //> Bound on the renamings tried when canonicalizing
+            static constexpr std::size_t MAX_CANONICAL_RENAMINGS = 5040;
+
+            /* Hash of a formula where the variable with the given id
+             * is marked, and the other variables are indistinct.
+             * */
+            static std::size_t marked_hash(const Formula& fmla, SymbolId var) {
+                if (fmla.type() == Formula::FmlaType::PROP)
+                    return static_cast<const Prop&>(fmla).symbol_id() == var ? 1 : 2;
+                const auto& compound = static_cast<const Compound&>(fmla);
+                std::size_t seed = std::hash<SymbolId>{}(compound.connective()->symbol_id());
+                for (const auto& c : compound.components())
+                    utils::hash_combine(seed, marked_hash(*c, var));
+                return seed;
+            }
+
+            /* The occurrences of a variable in the sequent, described in
+             * a way that does not depend on the names of the variables.
+             * */
+            std::vector<std::vector<std::size_t>> renaming_invariant_key(const Prop& prop) const {
+                std::vector<std::vector<std::size_t>> key (_sequent_fmlas.size());
+                for (auto i {0}; i < _sequent_fmlas.size(); ++i) {
+                    for (const auto& fmla : _sequent_fmlas[i])
+                        if (fmla->has_variable(prop.symbol_id()))
+                            key[i].push_back(marked_hash(*fmla, prop.symbol_id()));
+                    std::sort(key[i].begin(), key[i].end());
+                }
+                return key;
+            }
+
+            std::vector<std::shared_ptr<Formula>> sorted_at(int i) const {
+                std::vector<std::shared_ptr<Formula>> fmlas {_sequent_fmlas[i].begin(), _sequent_fmlas[i].end()};
+                std::sort(fmlas.begin(), fmlas.end(), utils::DeepSharedPointerComp<Formula>());
+                return fmlas;
+            }
+
+            /* Order the sequents by their positions, each
+             * seen as an ordered sequence of formulas.
+             * */
+            bool precedes(const NdSequent<FmlaContainerT>& other) const {
+                for (auto i {0}; i < _sequent_fmlas.size() and i < other._sequent_fmlas.size(); ++i) {
+                    auto fmlas = sorted_at(i);
+                    auto other_fmlas = other.sorted_at(i);
+                    utils::DeepSharedPointerComp<Formula> comp;
+                    if (std::lexicographical_compare(fmlas.begin(), fmlas.end(), 
+                                other_fmlas.begin(), other_fmlas.end(), comp))
+                        return true;
+                    if (std::lexicographical_compare(other_fmlas.begin(), other_fmlas.end(), 
+                                fmlas.begin(), fmlas.end(), comp))
+                        return false;
+                }
+                return _sequent_fmlas.size() < other._sequent_fmlas.size();
+            }
+
         public:
 
             NdSequent(size_t dimension) : _dimension {dimension} {
@@ -133,14 +188,92 @@ namespace ltsy {
 
             bool operator==(const NdSequent<FmlaContainerT>& other) const {
                 for (int i = 0; i < _sequent_fmlas.size(); ++i) {
-                    auto other_fmlas = other.sequent_fmlas()[i];        
-                    auto current_fmlas = _sequent_fmlas[i];        
-                    if (other_fmlas != current_fmlas)
+                    if (not utils::equals(other._sequent_fmlas[i], _sequent_fmlas[i]))
                         return false;
                 }
                 return true;
             }
 
+            /* Order-independent hash of the formulas in each position.
+             * Equal sequents have equal hashes.
+             * */
+            std::size_t hash() const {
+                std::size_t seed = _sequent_fmlas.size();
+                for (const auto& fmlas : _sequent_fmlas) {
+                    std::size_t position_hash = fmlas.size();
+                    for (const auto& f : fmlas) {
+                        std::size_t h = 0;
+                        utils::hash_combine(h, f->hash());
+                        position_hash += h;
+                    }
+                    utils::hash_combine(seed, position_hash);
+                }
+                return seed;
+            }
+
+            /* The variant of the sequent whose variables are renamed
+             * to p1, p2, ..., in a normal order. Sequents differing only
+             * by a renaming of variables have the same canonical form.
+             *
+             * Variables are ordered by how they occur in the sequent, and
+             * the renamings of the variables occurring alike are tried,
+             * keeping the least result. When there are more than
+             * MAX_CANONICAL_RENAMINGS of them, only the first ones are
+             * tried, and some renamings may be left with distinct forms.
+             * */
+            NdSequent<FmlaContainerT> canonical() const {
+                using Keyed = std::pair<std::vector<std::vector<std::size_t>>, std::shared_ptr<Prop>>;
+                std::vector<Keyed> keyed;
+                for (const auto& p : collect_props())
+                    keyed.push_back({renaming_invariant_key(*p), p});
+                std::stable_sort(keyed.begin(), keyed.end(), 
+                        [](const Keyed& a, const Keyed& b) { return a.first < b.first; });
+                std::vector<std::shared_ptr<Prop>> order;
+                std::vector<std::pair<std::size_t, std::size_t>> ties;
+                for (std::size_t i = 0; i < keyed.size(); ++i) {
+                    order.push_back(keyed[i].second);
+                    if (i == 0 or keyed[i].first != keyed[i-1].first)
+                        ties.push_back({i, i + 1});
+                    else
+                        ties.back().second = i + 1;
+                }
+                std::vector<std::shared_ptr<Formula>> names;
+                for (std::size_t i = 0; i < order.size(); ++i)
+                    names.push_back(std::make_shared<Prop>("p" + std::to_string(i + 1)));
+                // odometer over the permutations of each group of ties
+                auto next_renaming = [&]() {
+                    for (auto it = ties.rbegin(); it != ties.rend(); ++it)
+                        if (std::next_permutation(order.begin() + it->first, order.begin() + it->second,
+                                    utils::DeepSharedPointerComp<Prop>()))
+                            return true;
+                    return false;
+                };
+                std::optional<NdSequent<FmlaContainerT>> best;
+                std::size_t budget = MAX_CANONICAL_RENAMINGS;
+                do {
+                    FormulaVarAssignment ass;
+                    for (std::size_t i = 0; i < order.size(); ++i)
+                        ass.set(*order[i], names[i]);
+                    auto candidate = apply_substitution(ass);
+                    if (not best or candidate.precedes(*best))
+                        best = candidate;
+                } while (--budget > 0 and next_renaming());
+                return *best;
+            }
+
+            /* Hash of the canonical form, equal for sequents
+             * differing only by a renaming of variables.
+             * */
+            std::size_t canonical_hash() const { return canonical().hash(); }
+
+            /* Check if the sequent can be obtained from another
+             * by renaming its variables.
+             * */
+            bool is_renaming_of(const NdSequent<FmlaContainerT>& other) const {
+                return _sequent_fmlas.size() == other._sequent_fmlas.size()
+                    and canonical() == other.canonical();
+            }
+
             bool is_dilution_of(const NdSequent<FmlaContainerT>& other) const {
                 for (int i = 0; i < _sequent_fmlas.size(); ++i) {
                     auto other_fmlas = other.sequent_fmlas()[i];        
@@ -157,12 +290,15 @@ namespace ltsy {
                 _sequent_fmlas[i] = container;
             }
 
-            NdSequent<FmlaContainerT> apply_substitution(const FormulaVarAssignment& ass) const {
+            NdSequent<FmlaContainerT> apply_substitution(const FormulaVarAssignment& ass,
+                    std::shared_ptr<FormulaFactory> factory = nullptr) const {
                 std::vector<FmlaContainerT<std::shared_ptr<Formula>, utils::DeepSharedPointerComp<Formula>>> res_sequent_fmlas;
+                // a single evaluator, so that subformulas shared by the
+                // positions are substituted once
+                SubstitutionEvaluator seval {ass, factory};
                 for (auto i {0}; i < _sequent_fmlas.size(); ++i) {
                     FmlaContainerT<std::shared_ptr<Formula>, utils::DeepSharedPointerComp<Formula>> container;
                     for (const auto& fm : _sequent_fmlas[i]) {
-                        SubstitutionEvaluator seval {ass};
                         auto sres = fm->accept(seval);
                         container.insert(container.end(), sres); 
                     }
@@ -195,6 +331,7 @@ namespace ltsy {
     };
 
     template class NdSequent<std::set>;
+    template class NdSequent<utils::DeepHashSet>;
 
     /* NdSequent-to-NdSequent bidimensional rule representation.
      * It contains a set of NdSequent-premises,
@@ -11,6 +11,13 @@
 #include "external/ProgressBar/ProgressBar.hpp"
 #include "spdlog/spdlog.h"
 #include <optional>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <limits>
+#include <deque>
 
 namespace ltsy {
     
@@ -34,6 +41,58 @@ namespace ltsy {
             std::map<int, std::string> _val_to_str; //> Maps a value to a string
             std::map<std::string, int> _str_to_val; //> Maps the string representation of a value to the value
 
+            /* The interpretation tables, with bitmask cells.
+             * */
+            std::vector<NDMaskTruthTable> mask_tables() const {
+                std::vector<NDMaskTruthTable> tables;
+                for (const auto& [s, ti] : *_interpretation)
+                    tables.emplace_back(*ti->truth_table());
+                return tables;
+            }
+
+            bool is_sub_matrix_total(ValueMask subvalues, const std::vector<NDMaskTruthTable>& tables) const {
+                if (subvalues.empty())
+                    return true;
+                for (const auto& tt : tables)
+                    if (not tt.is_sub_table_total(subvalues))
+                        return false;
+                return true;
+            }
+
+            void get_maximal_total_subsets(const std::set<int>& values, 
+                    std::set<std::set<int>>& maximal_total_subsets,
+                    const std::vector<NDMaskTruthTable>& tables) const {
+                if (values.empty()) 
+                    return;
+                bool is_sub_total = is_sub_matrix_total(ValueMask {values}, tables);
+                if (is_sub_total) {
+                    maximal_total_subsets.insert(values);
+                    return;
+                }
+                std::vector<int> values_vec {values.begin(), values.end()};
+                // get all subsets of size (N-1)
+                DiscretureCombinationGenerator combination_gen {values.size(), values.size() - 1}; 
+                while (combination_gen.has_next()) {
+                   auto combidxs = *(combination_gen.next());
+                   if (combidxs.empty()) continue;
+                   // compose the combination
+                   std::set<int> comb;
+                   for (auto i : combidxs) 
+                       comb.insert(values_vec[i]);
+                   // check if subset of maximal
+                   bool subset_of_maximal = false;
+                   for (const auto& mts : maximal_total_subsets) {
+                       if (utils::is_subset(comb, mts)) {
+                           subset_of_maximal = true;
+                           break;
+                       }
+                   }
+                   // recursive call if not subset of maximal
+                   if (not subset_of_maximal)
+                       get_maximal_total_subsets(comb, maximal_total_subsets, tables);
+                }
+            }
+
         public:
 
             /* Construct a generalized matrix.
@@ -133,35 +192,7 @@ namespace ltsy {
              * */
             inline void get_maximal_total_subsets(const std::set<int> values, 
                     std::set<std::set<int>>& maximal_total_subsets) const {
-                if (values.empty()) 
-                    return;
-                bool is_sub_total = is_sub_matrix_total(values);
-                if (is_sub_total) {
-                    maximal_total_subsets.insert(values);
-                    return;
-                }
-                std::vector<int> values_vec {values.begin(), values.end()};
-                // get all subsets of size (N-1)
-                DiscretureCombinationGenerator combination_gen {values.size(), values.size() - 1}; 
-                while (combination_gen.has_next()) {
-                   auto combidxs = *(combination_gen.next());
-                   if (combidxs.empty()) continue;
-                   // compose the combination
-                   std::set<int> comb;
-                   for (auto i : combidxs) 
-                       comb.insert(values_vec[i]);
-                   // check if subset of maximal
-                   bool subset_of_maximal = false;
-                   for (const auto& mts : maximal_total_subsets) {
-                       if (utils::is_subset(comb, mts)) {
-                           subset_of_maximal = true;
-                           break;
-                       }
-                   }
-                   // recursive call if not subset of maximal
-                   if (not subset_of_maximal)
-                       get_maximal_total_subsets(comb, maximal_total_subsets);
-                }
+                get_maximal_total_subsets(values, maximal_total_subsets, mask_tables());
             }
     };
 
@@ -234,6 +265,7 @@ namespace ltsy {
 
             std::shared_ptr<GenMatrix> _nmatrix_ptr;
             std::map<Prop, int> _valuation_map;
+            std::vector<int> _values_by_id; //> Same assignment, indexed by variable symbol id
             
         public:
 
@@ -254,6 +286,9 @@ namespace ltsy {
                     auto [p, v] = mapping;
                     if (v >= 0 and v < values.size()) {
                         _valuation_map.insert(mapping);
+                        if (p.symbol_id() >= _values_by_id.size())
+                            _values_by_id.resize(p.symbol_id() + 1, 0);
+                        _values_by_id[p.symbol_id()] = v;
                     } else {
                         throw std::invalid_argument(INVALID_TRUTH_VALUE_EXCEPTION);
                     }
@@ -284,8 +319,15 @@ namespace ltsy {
                 return _nmatrix_ptr;
             }
             
-            inline int operator()(const Prop& p) {
-                return _valuation_map[p];
+            inline int operator()(const Prop& p) const {
+                return (*this)(p.symbol_id());
+            }
+
+            /* The value of the variable with the given symbol id,
+             * 0 if not assigned.
+             * */
+            inline int operator()(SymbolId id) const {
+                return id < _values_by_id.size() ? _values_by_id[id] : 0;
             }
 
             /* Checks if the valuation is a model for the given set
@@ -326,21 +368,13 @@ namespace ltsy {
             std::set<int> visit_compound(Compound* compound) override {
                if (compound != nullptr) {
                    auto connective = compound->connective();
-                   auto conn_interp = 
+                   const auto& conn_interp = 
                        _matrix_valuation_ptr->nmatrix_ptr()->interpretation()
-                           ->get_interpretation(connective->symbol());
-                   auto components = compound->components();
-                   std::vector<std::set<int>> args;
-                   for (auto component : components) {
-                        args.push_back(component->accept(*this));
-                   }
-                   auto possible_arguments = utils::cartesian_product(args);
-                   std::set<int> result;
-                   for (const auto& arg : possible_arguments) {
-                      auto conn_values = conn_interp->at(arg);
-                      result.insert(conn_values.begin(), conn_values.end());
-                   }
-                   return result;
+                           ->get_interpretation(connective->symbol_id());
+                   std::vector<ValueMask> args;
+                   for (const auto& component : compound->components())
+                        args.push_back(ValueMask {component->accept(*this)});
+                   return conn_interp->image(args).to_set();
                } else throw std::logic_error("compound points to null");
             }
     };
@@ -356,6 +390,7 @@ namespace ltsy {
             std::vector<std::shared_ptr<Prop>> _props;
             int _current_index = 0;
             unsigned long long int _total_valuations;
+            utils::RowCursor _images; //> Values of the variables in the next assignment
 
         public:
 
@@ -366,6 +401,7 @@ namespace ltsy {
                 auto number_props = _props.size();
                 auto nvalues = _matrix->values().size();
                 _total_valuations = std::pow(nvalues, number_props); 
+                _images = utils::RowCursor {static_cast<int>(nvalues), static_cast<int>(number_props)};
             }
 
             bool has_next() {
@@ -374,17 +410,18 @@ namespace ltsy {
 
             void reset() {
                 _current_index = 0;
+                _images.reset();
             }
 
             std::shared_ptr<GenMatrixVarAssignment> next() {
                 if (not has_next())
                     throw std::logic_error("no valuations to generate");
-                auto images = utils::tuple_from_position(_matrix->values().size(), _props.size(), _current_index);
                 std::vector<std::pair<Prop, int>> val_map;
                 for (int i = 0; i < _props.size(); ++i) {
                     Prop p = *_props[i];
-                    val_map.push_back({p, images[i]});
+                    val_map.push_back({p, _images[i]});
                 }
+                _images.next();
                 ++_current_index;
                 return std::make_shared<GenMatrixVarAssignment>(_matrix, val_map); 
             }
@@ -447,10 +484,14 @@ namespace ltsy {
                 _var_assignment = var_assignment;
             }
 
-            inline int operator()(const Prop& p) {
+            inline int operator()(const Prop& p) const {
                 return (*_var_assignment)(p);
             }
 
+            inline int operator()(SymbolId id) const {
+                return (*_var_assignment)(id);
+            }
+
             std::stringstream print(const std::map<int, std::string>& values_map) const {
                 std::stringstream ss;
                 ss << _interpretation->print(values_map).str() << std::endl;
@@ -477,38 +518,102 @@ namespace ltsy {
     class GenMatrixEvaluator : public FormulaVisitor<std::set<int>> {
         private:
             std::shared_ptr<GenMatrixValuation> _matrix_valuation_ptr;
+            const GenMatrixValuation* _valuation; //> the valuation, owned or not
+            std::vector<ValueMask> _args;
+            // memoized evaluation of the formulas given to evaluate_mask
+            FormulaPool _memo_pool;
+            std::vector<ValueMask> _memo_values;
+            std::vector<std::shared_ptr<TruthInterp<std::set<int>>>> _memo_interps;
+
+            /* Evaluate the nodes of a pool from values.size() on, given the values
+             * of the previous ones.
+             *
+             * @param interps the interpretations of the connectives already looked up
+             * */
+            void evaluate_nodes(const FormulaPool& pool, std::vector<ValueMask>& values,
+                    std::vector<std::shared_ptr<TruthInterp<std::set<int>>>>& interps) {
+                interps.resize(pool.connectives().size());
+                for (std::size_t i = values.size(); i < pool.size(); ++i) {
+                    const auto& node = pool.node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        values.push_back(ValueMask::singleton((*_valuation)(pool.variables()[node.symbol])));
+                        continue;
+                    } 
+                    auto& conn_interp = interps[node.symbol];
+                    if (conn_interp == nullptr)
+                        conn_interp = _valuation->interpretation()
+                            ->get_interpretation(pool.connectives()[node.symbol]->symbol_id());
+                    _args.resize(node.arity);
+                    for (std::size_t k = 0; k < node.arity; ++k)
+                        _args[k] = values[pool.child(i, k)];
+                    values.push_back(conn_interp->truth_table()->image(_args));
+                }
+            }
 
         public:
 
             GenMatrixEvaluator(decltype(_matrix_valuation_ptr) matrix_valuation_ptr) :
-                _matrix_valuation_ptr {matrix_valuation_ptr} {/* empty */}
+                _matrix_valuation_ptr {matrix_valuation_ptr}, 
+                _valuation {_matrix_valuation_ptr.get()} {/* empty */}
+
+            /* Evaluator over a valuation that is not copied, 
+             * hence which must outlive the evaluator.
+             * */
+            GenMatrixEvaluator(const GenMatrixValuation& valuation) :
+                _valuation {&valuation} {/* empty */}
 
             std::set<int> visit_prop(Prop* prop) override {
                 if (prop != nullptr) {
-                    return std::set<int>{(*_matrix_valuation_ptr)(*prop)};
+                    return std::set<int>{(*_valuation)(*prop)};
                 } else throw std::logic_error("proposition points to null");
             }
 
             std::set<int> visit_compound(Compound* compound) override {
                if (compound != nullptr) {
                    auto connective = compound->connective();
-                   auto conn_interp = 
-                       _matrix_valuation_ptr->interpretation()
-                           ->get_interpretation(connective->symbol());
-                   auto components = compound->components();
-                   std::vector<std::set<int>> args;
-                   for (auto component : components) {
-                        args.push_back(component->accept(*this));
-                   }
-                   auto possible_arguments = utils::cartesian_product(args);
-                   std::set<int> result;
-                   for (const auto& arg : possible_arguments) {
-                      auto conn_values = conn_interp->at(arg);
-                      result.insert(conn_values.begin(), conn_values.end());
-                   }
-                   return result;
+                   const auto& conn_interp = 
+                       _valuation->interpretation()
+                           ->get_interpretation(connective->symbol_id());
+                   std::vector<ValueMask> args;
+                   for (const auto& component : compound->components())
+                        args.push_back(ValueMask {component->accept(*this)});
+                   return conn_interp->truth_table()->image(args).to_set();
                } else throw std::logic_error("compound points to null");
             }
+
+            /* Evaluate every node of a formula pool in a single
+             * pass, as children come before their parents.
+             *
+             * @return the possible values of each node, as bitmasks, indexed as in the pool
+             * */
+            std::vector<ValueMask> evaluate_masks(const FormulaPool& pool) {
+                std::vector<ValueMask> values;
+                values.reserve(pool.size());
+                std::vector<std::shared_ptr<TruthInterp<std::set<int>>>> interps;
+                evaluate_nodes(pool, values, interps);
+                return values;
+            }
+
+            /* The possible values of a formula, memoizing those of
+             * its subformulas: a subformula shared by several formulas
+             * given to this evaluator is evaluated once.
+             * */
+            ValueMask evaluate_mask(const std::shared_ptr<Formula>& fmla) {
+                auto node = _memo_pool.add(fmla);
+                evaluate_nodes(_memo_pool, _memo_values, _memo_interps);
+                return _memo_values[node];
+            }
+
+            /* Same as evaluate_masks, giving sets of values.
+             * */
+            std::vector<std::set<int>> evaluate(const FormulaPool& pool) {
+                auto masks = evaluate_masks(pool);
+                std::vector<std::set<int>> values;
+                values.reserve(masks.size());
+                for (const auto& m : masks)
+                    values.push_back(m.to_set());
+                return values;
+            }
     };
 
 
@@ -539,8 +644,7 @@ namespace ltsy {
                          tt_start->arity());
                 _total = 1;
                 // fill in the possible images
-                auto determinants = _tt_start->get_determinants();
-                for (const auto& d : determinants) {
+                for (const auto& d : _tt_start->determinants()) {
                     std::vector<std::set<int>> imgs;
                     if (d.get_last().empty())
                         imgs.push_back({});
@@ -797,6 +901,610 @@ namespace ltsy {
     
     };
 
+    /* Random access to the valuations of a generalized matrix 
+     * over some variables: a valuation is indexed by a 
+     * mixed-radix number whose digits correspond to the values of
+     * the variables (least significant first), followed by the choice
+     * of image in each non-deterministic row of the interpretation.
+     * A range of indices can then be visited independently
+     * of the others, e.g. by another thread.
+     *
+     * The digits of an index are read as a reflected mixed-radix
+     * Gray code, so that consecutive valuations differ in the value
+     * of a single variable or in the image of a single row, given 
+     * by last_change.
+     *
+     * If the range is restricted to the formulas of a pool, 
+     * the valuations are grouped by variable assignment, and only the
+     * rows that the formulas may reach under each assignment 
+     * are determinized in all possible ways, the others taking their
+     * first image. Inside a group, the digits are the choices of
+     * image of the reachable rows.
+     *
+     * The valuation given by next is updated in place.
+     *
+     * @author Vitor Greati
+     * */
+    class GenMatrixValuationRange {
+
+        public:
+            using Index = unsigned long long int;
+
+            /* Difference between the valuation given by next
+             * and the previous one.
+             * */
+            struct Change {
+                bool full = true; //> if the valuation must be taken as a whole, e.g. after a seek
+                bool variable = false; //> if a variable changed, otherwise a row of a table
+                std::size_t index = 0; //> index of the variable or of the table
+                int row = 0; //> the row of the table
+            };
+
+        private:
+            struct Cell {
+                std::size_t table; //> index in the determinized tables
+                int row;
+                bool operator<(const Cell& other) const { 
+                    return std::tie(table, row) < std::tie(other.table, other.row); 
+                }
+            };
+
+            std::shared_ptr<GenMatrix> _matrix;
+            std::vector<std::shared_ptr<Prop>> _props;
+            std::shared_ptr<Signature> _signature;
+            std::vector<std::shared_ptr<Connective>> _connectives; //> connective of each table
+            std::vector<std::shared_ptr<TruthTable<std::set<int>>>> _tables; //> determinized tables
+            std::vector<std::vector<std::vector<std::set<int>>>> _images; //> possible images, by table and row
+            std::vector<Cell> _cells; //> rows determinized in all possible ways
+            std::vector<int> _radices;
+            std::vector<int> _counter; //> digits of the current index
+            std::vector<int> _digits; //> Gray digits of the current index
+            std::vector<int> _directions; //> direction in which each Gray digit moves
+            std::size_t _first_gray = 0; //> first digit read as a Gray code
+            Index _total = 1;
+            Index _current = 0;
+            Index _end = 0;
+            bool _fresh = true; //> if the digits already give the next valuation
+            Change _last_change;
+            std::shared_ptr<GenMatrixValuation> _valuation;
+            // restriction to the formulas of a pool
+            std::shared_ptr<const FormulaPool> _pool;
+            std::vector<std::shared_ptr<TruthInterp<std::set<int>>>> _pool_interps; //> by pool connective
+            std::vector<std::size_t> _pool_tables; //> table of each pool connective
+            std::vector<std::size_t> _pool_variables; //> variable of each pool variable
+            std::shared_ptr<const std::vector<Index>> _offsets; //> first index of each assignment, and the total
+            std::size_t _assignment = 0;
+
+            GenMatrixValuationRange(const GenMatrixValuationRange& other, Index begin, Index end) 
+                : _matrix {other._matrix}, _props {other._props}, _signature {other._signature}, 
+                  _first_gray {other._first_gray}, _pool {other._pool}, _offsets {other._offsets} {
+                init();
+                if (_pool != nullptr)
+                    _total = _offsets->back();
+                else
+                    determinize_all_rows();
+                set_range(begin, end);
+            }
+
+            /* Make every row with several images a digit.
+             * */
+            void determinize_all_rows() {
+                auto nvalues = static_cast<int>(_matrix->values().size());
+                _radices.assign(_props.size(), nvalues);
+                for (std::size_t t = 0; t < _tables.size(); ++t)
+                    for (int row = 0; row < _tables[t]->number_of_rows(); ++row)
+                        if (_images[t][row].size() > 1) {
+                            _radices.push_back(_images[t][row].size());
+                            _cells.push_back({t, row});
+                        }
+                for (auto radix : _radices)
+                    if (__builtin_mul_overflow(_total, static_cast<Index>(radix), &_total))
+                        throw std::overflow_error("too many valuations to index");
+                _counter.assign(_radices.size(), 0);
+                _digits.assign(_radices.size(), 0);
+                _directions.assign(_radices.size(), 1);
+            }
+
+            /* Build the determinized tables, all at their first images.
+             * */
+            void init() {
+                auto interp = std::make_shared<SignatureTruthInterp<std::set<int>>>(_signature);
+                for (auto [symbol, connective] : *_signature) {
+                    auto table = _matrix->interpretation()->get_interpretation(symbol)->truth_table();
+                    auto det = std::make_shared<TruthTable<std::set<int>>>(table->nvalues(), table->arity());
+                    _images.emplace_back(table->number_of_rows());
+                    for (int row = 0; row < table->number_of_rows(); ++row) {
+                        auto& images = _images.back()[row];
+                        if (table->image_at(row).empty())
+                            images.push_back({});
+                        else
+                            for (auto v : table->image_at(row))
+                                images.push_back({v});
+                        det->set(row, images[0]);
+                    }
+                    _connectives.push_back(connective);
+                    _tables.push_back(det);
+                    interp->try_interpret(std::make_shared<TruthInterp<std::set<int>>>(connective, det), true);
+                }
+                _valuation = std::make_shared<GenMatrixValuation>(nullptr, interp);
+                if (_pool != nullptr) {
+                    std::unordered_map<SymbolId, std::size_t> variable_ids, table_ids;
+                    for (std::size_t v = 0; v < _props.size(); ++v)
+                        variable_ids[_props[v]->symbol_id()] = v;
+                    for (std::size_t t = 0; t < _connectives.size(); ++t)
+                        table_ids[_connectives[t]->symbol_id()] = t;
+                    for (const auto& p : _pool->variables())
+                        _pool_variables.push_back(variable_ids.at(p.symbol_id()));
+                    for (const auto& c : _pool->connectives()) {
+                        _pool_tables.push_back(table_ids.at(c->symbol_id()));
+                        _pool_interps.push_back(_matrix->interpretation()->get_interpretation(c->symbol_id()));
+                    }
+                }
+            }
+
+            void set_range(Index begin, std::optional<Index> end) {
+                _end = end.value_or(_total);
+                if (begin > _end or _end > _total)
+                    throw std::invalid_argument("invalid range of valuations");
+                seek(begin);
+            }
+
+            std::size_t number_of_assignments() const { return _offsets->size() - 1; }
+
+            /* The rows which the formulas of the pool may reach
+             * under a variable assignment, having more than one image.
+             * */
+            std::vector<Cell> reachable_cells(std::size_t assignment) const {
+                auto nvalues = static_cast<int>(_matrix->values().size());
+                std::vector<int> values (_props.size());
+                for (auto& v : values) {
+                    v = assignment % nvalues;
+                    assignment /= nvalues;
+                }
+                std::set<Cell> cells;
+                std::vector<ValueMask> masks (_pool->size());
+                std::vector<ValueMask> args;
+                for (std::size_t i = 0; i < _pool->size(); ++i) {
+                    const auto& node = _pool->node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        masks[i] = ValueMask::singleton(values[_pool_variables[node.symbol]]);
+                        continue;
+                    }
+                    args.resize(node.arity);
+                    for (std::size_t k = 0; k < node.arity; ++k)
+                        args[k] = masks[_pool->child(i, k)];
+                    auto t = _pool_tables[node.symbol];
+                    _tables[t]->for_each_row_in(args, [&](int row) {
+                        if (_images[t][row].size() > 1)
+                            cells.insert({t, row});
+                    });
+                    masks[i] = _pool_interps[node.symbol]->image(args);
+                }
+                return {cells.begin(), cells.end()};
+            }
+
+            void set_digit(std::size_t d, int v) {
+                _digits[d] = v;
+                if (d >= _props.size()) {
+                    const auto& cell = _cells[d - _props.size()];
+                    _tables[cell.table]->set(cell.row, _images[cell.table][cell.row][v]);
+                }
+            }
+
+            /* Move to the group of valuations of a variable assignment.
+             * */
+            void enter_assignment(std::size_t assignment) {
+                for (const auto& cell : _cells)
+                    _tables[cell.table]->set(cell.row, _images[cell.table][cell.row][0]);
+                _assignment = assignment;
+                _cells = reachable_cells(assignment);
+                auto nvalues = static_cast<int>(_matrix->values().size());
+                _radices.assign(_props.size(), nvalues);
+                for (const auto& cell : _cells)
+                    _radices.push_back(_images[cell.table][cell.row].size());
+                _counter.assign(_radices.size(), 0);
+                _digits.assign(_radices.size(), 0);
+                _directions.assign(_radices.size(), 1);
+                for (std::size_t d = 0; d < _props.size(); ++d) {
+                    set_digit(d, assignment % nvalues);
+                    assignment /= nvalues;
+                }
+            }
+
+            /* Set the Gray digits from the given index of the digits
+             * read as a Gray code.
+             * */
+            void seek_gray(Index index) {
+                for (std::size_t d = _first_gray; d < _digits.size(); ++d) {
+                    _counter[d] = index % _radices[d];
+                    index /= _radices[d];
+                    // the digit is reflected when the higher digits give an odd number
+                    _directions[d] = index % 2 == 0 ? 1 : -1;
+                    set_digit(d, _directions[d] == 1 ? _counter[d] : _radices[d] - 1 - _counter[d]);
+                }
+            }
+
+            /* Increment the index: the digits below the first one
+             * that does not carry are reflected, hence keep their
+             * Gray digits and reverse their directions.
+             * */
+            void advance() {
+                if (_pool != nullptr and _current == (*_offsets)[_assignment + 1]) {
+                    enter_assignment(_assignment + 1);
+                    _last_change = Change {};
+                    return;
+                }
+                std::size_t d = _first_gray;
+                while (_counter[d] + 1 == _radices[d]) {
+                    _counter[d] = 0;
+                    _directions[d] = -_directions[d];
+                    ++d;
+                }
+                ++_counter[d];
+                set_digit(d, _digits[d] + _directions[d]);
+                if (d < _props.size())
+                    _last_change = Change {false, true, d, 0};
+                else
+                    _last_change = Change {false, false, _cells[d - _props.size()].table, 
+                        _cells[d - _props.size()].row};
+            }
+
+        public:
+
+            /* Constructor.
+             *
+             * @param matrix the generalized matrix
+             * @param props the variables
+             * @param signature the connectives to determinize
+             * @param begin the first index of the range
+             * @param end the index after the last one of the range, the total if absent
+             * */
+            GenMatrixValuationRange(decltype(_matrix) matrix, const decltype(_props)& props,
+                    std::shared_ptr<Signature> signature, Index begin = 0, 
+                    std::optional<Index> end = std::nullopt) 
+                : _matrix {matrix}, _props {props}, _signature {signature} {
+                init();
+                determinize_all_rows();
+                set_range(begin, end);
+            }
+
+            /* Constructor of a range restricted to the
+             * rows reachable by the formulas of a pool.
+             *
+             * @param pool the formulas, whose variables and connectives
+             * must be among the given ones
+             * */
+            GenMatrixValuationRange(decltype(_matrix) matrix, const decltype(_props)& props,
+                    std::shared_ptr<Signature> signature, const FormulaPool& pool, Index begin = 0, 
+                    std::optional<Index> end = std::nullopt) 
+                : _matrix {matrix}, _props {props}, _signature {signature},
+                  _first_gray {props.size()}, _pool {std::make_shared<FormulaPool>(pool)} {
+                init();
+                Index assignments = 1;
+                for (std::size_t i = 0; i < _props.size(); ++i)
+                    if (__builtin_mul_overflow(assignments, static_cast<Index>(_matrix->values().size()), &assignments))
+                        throw std::overflow_error("too many valuations to index");
+                auto offsets = std::make_shared<std::vector<Index>>(assignments + 1, 0);
+                for (std::size_t a = 0; a < assignments; ++a) {
+                    Index group = 1;
+                    for (const auto& cell : reachable_cells(a))
+                        if (__builtin_mul_overflow(group, static_cast<Index>(_images[cell.table][cell.row].size()), &group))
+                            throw std::overflow_error("too many valuations to index");
+                    if (__builtin_add_overflow((*offsets)[a], group, &(*offsets)[a + 1]))
+                        throw std::overflow_error("too many valuations to index");
+                }
+                _offsets = offsets;
+                _total = _offsets->back();
+                set_range(begin, end);
+            }
+
+            /* The same range of valuations, restricted to the given indices,
+             * with its own determinized tables.
+             * */
+            GenMatrixValuationRange slice(Index begin, Index end) const {
+                return GenMatrixValuationRange {*this, begin, end};
+            }
+
+            inline Index total() const { return _total; }
+            inline Index current_index() const { return _current; }
+            inline Index end_index() const { return _end; }
+
+            inline const decltype(_props)& props() const { return _props; }
+            inline const decltype(_connectives)& connectives() const { return _connectives; }
+            inline const decltype(_tables)& tables() const { return _tables; }
+
+            /* Value of the i-th variable in the last valuation given.
+             * */
+            inline int value(std::size_t i) const { return _digits[i]; }
+
+            inline const Change& last_change() const { return _last_change; }
+
+            /* Make the valuation of the given index the next one.
+             * */
+            void seek(Index index) {
+                _current = index;
+                if (_pool != nullptr) {
+                    auto assignment = std::upper_bound(_offsets->begin(), _offsets->end(), index) 
+                        - _offsets->begin() - 1;
+                    assignment = std::min<std::size_t>(assignment, number_of_assignments() - 1);
+                    enter_assignment(assignment);
+                    index -= (*_offsets)[assignment];
+                }
+                seek_gray(index);
+                _fresh = true;
+            }
+
+            inline bool has_next() const { return _current < _end; }
+
+            /* Move to the next valuation, without building it:
+             * its values are given by value, and the valuation
+             * itself by valuation, only when needed.
+             * */
+            void step() {
+                if (not has_next())
+                    throw std::logic_error("no next valuation to generate");
+                if (_fresh)
+                    _last_change = Change {};
+                else
+                    advance();
+                _fresh = false;
+                ++_current;
+            }
+
+            /* The current valuation, whose interpretation
+             * changes with the next steps.
+             * */
+            std::shared_ptr<GenMatrixValuation> valuation() {
+                std::vector<std::pair<Prop, int>> mappings;
+                for (std::size_t i = 0; i < _props.size(); ++i)
+                    mappings.push_back({*_props[i], _digits[i]});
+                _valuation->set_var_assignment(std::make_shared<GenMatrixVarAssignment>(_matrix, mappings));
+                return _valuation;
+            }
+
+            std::shared_ptr<GenMatrixValuation> next() {
+                step();
+                return valuation();
+            }
+    };
+
+    /* Values of the nodes of a formula pool under the valuations
+     * given by a GenMatrixValuationRange: after each step of the range,
+     * only the nodes depending on the variable or on the table row 
+     * that changed are evaluated again, and then their ancestors
+     * while their values change.
+     *
+     * @author Vitor Greati
+     * */
+    class GenMatrixIncrementalEvaluator {
+
+        private:
+            static constexpr int NO_ROW = -1;
+
+            const FormulaPool& _pool;
+            const GenMatrixValuationRange& _range;
+            std::vector<ValueMask> _values;
+            std::vector<int> _rows; //> row of its table reached by each compound node, if any
+            std::vector<std::size_t> _variable; //> variable of the range at each variable node
+            std::vector<std::size_t> _table; //> table of the range of each compound node
+            std::vector<std::vector<std::size_t>> _parents;
+            std::vector<std::vector<std::size_t>> _nodes_of_variable; //> by variable of the range
+            std::vector<std::vector<std::size_t>> _nodes_of_table; //> by table of the range
+            std::vector<char> _pending;
+
+            /* Evaluate a node from the values of its children.
+             * */
+            ValueMask evaluate_node(std::size_t i) {
+                const auto& node = _pool.node(i);
+                if (node.type == Formula::FmlaType::PROP)
+                    return ValueMask::singleton(_range.value(_variable[i]));
+                int row = 0;
+                for (std::size_t k = 0; k < node.arity; ++k) {
+                    auto arg = _values[_pool.child(i, k)];
+                    if (arg.empty()) {
+                        _rows[i] = NO_ROW;
+                        return ValueMask {};
+                    }
+                    row = row * _range.tables()[_table[i]]->nvalues() + __builtin_ctzll(arg.bits());
+                }
+                _rows[i] = row;
+                return ValueMask {_range.tables()[_table[i]]->image_at(row)};
+            }
+
+            void evaluate_all() {
+                for (std::size_t i = 0; i < _pool.size(); ++i)
+                    _values[i] = evaluate_node(i);
+            }
+
+            /* Evaluate the pending nodes in post-order, making
+             * the parents of those whose values change pending.
+             * */
+            void propagate(std::size_t first) {
+                for (std::size_t i = first; i < _pool.size(); ++i) {
+                    if (not _pending[i])
+                        continue;
+                    _pending[i] = false;
+                    auto value = evaluate_node(i);
+                    if (value != _values[i]) {
+                        _values[i] = value;
+                        for (auto parent : _parents[i])
+                            _pending[parent] = true;
+                    }
+                }
+            }
+
+        public:
+
+            /* Constructor.
+             *
+             * @param pool the formulas, whose connectives and variables must be in the range
+             * @param range the valuations
+             * */
+            GenMatrixIncrementalEvaluator(const FormulaPool& pool, const GenMatrixValuationRange& range)
+                : _pool {pool}, _range {range}, _values (pool.size()), _rows (pool.size(), NO_ROW),
+                  _variable (pool.size()), _table (pool.size()), _parents (pool.size()),
+                  _nodes_of_variable (range.props().size()), _nodes_of_table (range.tables().size()),
+                  _pending (pool.size(), false) {
+                std::unordered_map<SymbolId, std::size_t> variable_ids, table_ids;
+                for (std::size_t v = 0; v < range.props().size(); ++v)
+                    variable_ids[range.props()[v]->symbol_id()] = v;
+                for (std::size_t t = 0; t < range.connectives().size(); ++t)
+                    table_ids[range.connectives()[t]->symbol_id()] = t;
+                for (std::size_t i = 0; i < pool.size(); ++i) {
+                    const auto& node = pool.node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        _variable[i] = variable_ids.at(pool.variables()[node.symbol].symbol_id());
+                        _nodes_of_variable[_variable[i]].push_back(i);
+                    } else {
+                        _table[i] = table_ids.at(pool.connectives()[node.symbol]->symbol_id());
+                        _nodes_of_table[_table[i]].push_back(i);
+                        for (std::size_t k = 0; k < node.arity; ++k)
+                            _parents[pool.child(i, k)].push_back(i);
+                    }
+                }
+            }
+
+            /* The values of the nodes under the last valuation
+             * given by the range.
+             * */
+            const std::vector<ValueMask>& update() {
+                const auto& change = _range.last_change();
+                if (change.full) {
+                    evaluate_all();
+                    return _values;
+                }
+                std::size_t first = _pool.size();
+                if (change.variable) {
+                    for (auto i : _nodes_of_variable[change.index]) {
+                        _pending[i] = true;
+                        first = std::min(first, i);
+                    }
+                } else {
+                    for (auto i : _nodes_of_table[change.index]) {
+                        if (_rows[i] == change.row) {
+                            _pending[i] = true;
+                            first = std::min(first, i);
+                        }
+                    }
+                }
+                propagate(first);
+                return _values;
+            }
+    };
+
+    /**
+     * Valuations of a generalized matrix that refuted some rules,
+     * to be tried first on other rules, since refuting valuations
+     * tend to recur among related rules.
+     *
+     * The valuations are grouped by the number of variables of the
+     * rule they refuted, and are given to a rule with as many
+     * variables by renaming these variables in order. The connectives
+     * not interpreted by a stored valuation take the first image of
+     * each row. The cache does not hold the matrix, which is given
+     * when the valuations are built. Safe for concurrent use.
+     *
+     * @author Vitor Greati
+     * */
+    class GenMatrixCounterExampleCache {
+
+        private:
+            struct Entry {
+                std::vector<int> values; //> value of each variable, in order
+                std::map<Symbol, std::shared_ptr<TruthTable<std::set<int>>>> tables; //> determinized tables
+            };
+
+            std::size_t _max_per_shape;
+            std::map<std::size_t, std::deque<Entry>> _entries; //> by number of variables
+            mutable std::mutex _mutex;
+
+        public:
+
+            /* Constructor.
+             *
+             * @param max_per_shape the number of valuations kept for each
+             * number of variables, the oldest ones being dropped
+             * */
+            GenMatrixCounterExampleCache(std::size_t max_per_shape = 64)
+                : _max_per_shape {max_per_shape} {/* empty */}
+
+            /* Store a valuation refuting a rule.
+             *
+             * @param props the variables of the rule, in order
+             * */
+            void add(const std::vector<std::shared_ptr<Prop>>& props, const GenMatrixValuation& val) {
+                Entry entry;
+                for (const auto& p : props)
+                    entry.values.push_back(val(*p));
+                for (auto& [symbol, interp] : *val.interpretation())
+                    entry.tables[symbol] = interp->truth_table();
+                std::lock_guard<std::mutex> lock {_mutex};
+                auto& entries = _entries[props.size()];
+                for (const auto& e : entries)
+                    if (e.values == entry.values and e.tables.size() == entry.tables.size() 
+                            and std::equal(e.tables.begin(), e.tables.end(), entry.tables.begin(),
+                                [](const auto& a, const auto& b) { 
+                                    return a.first == b.first and *a.second == *b.second; }))
+                        return;
+                entries.push_back(entry);
+                if (entries.size() > _max_per_shape)
+                    entries.pop_front();
+            }
+
+            /* The stored valuations for a rule.
+             *
+             * @param matrix the matrix of the valuations
+             * @param props the variables of the rule, in order
+             * @param sig the signature of the rule
+             * */
+            std::vector<GenMatrixValuation> candidates(std::shared_ptr<GenMatrix> matrix,
+                    const std::vector<std::shared_ptr<Prop>>& props, std::shared_ptr<Signature> sig) const {
+                std::deque<Entry> entries;
+                {
+                    std::lock_guard<std::mutex> lock {_mutex};
+                    auto it = _entries.find(props.size());
+                    if (it == _entries.end())
+                        return {};
+                    entries = it->second;
+                }
+                std::map<Symbol, std::shared_ptr<TruthTable<std::set<int>>>> first_images;
+                std::vector<GenMatrixValuation> result;
+                for (const auto& entry : entries) {
+                    std::vector<std::pair<Prop, int>> mappings;
+                    for (std::size_t i = 0; i < props.size(); ++i)
+                        mappings.push_back({*props[i], entry.values[i]});
+                    auto interp = std::make_shared<SignatureTruthInterp<std::set<int>>>(sig);
+                    for (auto [symbol, connective] : *sig) {
+                        auto it = entry.tables.find(symbol);
+                        auto det = it != entry.tables.end() ? it->second : first_images[symbol];
+                        if (det == nullptr) {
+                            auto table = matrix->interpretation()->get_interpretation(symbol)->truth_table();
+                            det = std::make_shared<TruthTable<std::set<int>>>(table->nvalues(), table->arity());
+                            for (int row = 0; row < table->number_of_rows(); ++row) {
+                                const auto& images = table->image_at(row);
+                                det->set(row, images.empty() ? std::set<int>{} : std::set<int>{*images.begin()});
+                            }
+                            first_images[symbol] = det;
+                        }
+                        interp->try_interpret(std::make_shared<TruthInterp<std::set<int>>>(connective, det), true);
+                    }
+                    auto var_assignment = std::make_shared<GenMatrixVarAssignment>(matrix, mappings);
+                    result.push_back(GenMatrixValuation{var_assignment, interp});
+                }
+                return result;
+            }
+
+            /* The number of valuations stored.
+             * */
+            std::size_t size() const {
+                std::lock_guard<std::mutex> lock {_mutex};
+                std::size_t n = 0;
+                for (const auto& [nvars, entries] : _entries)
+                    n += entries.size();
+                return n;
+            }
+    };
+
     /* Check if a sequent is valid on a given
      * generalized matrix. Validity is defined in the form
      * of: there is no valuation v such that
@@ -820,6 +1528,332 @@ namespace ltsy {
             std::shared_ptr<GenMatrix> _matrix; 
             std::vector<int> _sequent_set_correspondence;
             std::vector<std::set<int>> _d_sets;
+            std::vector<ValueMask> _d_masks;
+
+            /* Node indices of the formulas of a sequent, by position,
+             * in a formula pool.
+             * */
+            using PooledSequent = std::vector<std::vector<std::size_t>>;
+
+            PooledSequent add_to_pool(FormulaPool& pool, const NdSequent<FmlaContainerT>& seq) const {
+                PooledSequent pooled (seq.dimension());
+                for (int i {0}; i < seq.dimension(); ++i)
+                    for (const auto& f : seq.at(i))
+                        pooled[i].push_back(pool.add(f));
+                return pooled;
+            }
+
+            /* Same as is_valid_under_valuation, given the values 
+             * of the pool nodes under the valuation.
+             * */
+            bool is_valid_under_values(const std::vector<ValueMask>& values, 
+                    const PooledSequent& seq) const {
+                for (int i {0}; i < seq.size(); ++i) {
+                    auto dset = _d_masks[_sequent_set_correspondence[i]];
+                    for (auto node : seq[i])
+                        if (not values[node].is_subset_of(dset))
+                            return true;
+                }
+                return false;
+            }
+
+            /* The formulas of a rule in a single pool, the
+             * premises coming first.
+             * */
+            struct PooledRule {
+                FormulaPool pool;
+                std::vector<PooledSequent> premises, conclusions;
+            };
+
+            PooledRule add_to_pool(const NdSequentRule<FmlaContainerT>& rule) const {
+                PooledRule pooled;
+                for (const auto& p : rule.premises())
+                    pooled.premises.push_back(add_to_pool(pooled.pool, p));
+                for (const auto& c : rule.conclusions())
+                    pooled.conclusions.push_back(add_to_pool(pooled.pool, c));
+                return pooled;
+            }
+
+            /* Whether the values of the formulas of a rule satisfy
+             * its premises but none of its conclusions.
+             * */
+            bool is_counter_example(const std::vector<ValueMask>& values, const PooledRule& rule) const {
+                for (const auto& p : rule.premises)
+                    if (not is_valid_under_values(values, p))
+                        return false;
+                for (const auto& c : rule.conclusions)
+                    if (is_valid_under_values(values, c))
+                        return false;
+                return true;
+            }
+
+            /* Visit the valuations of a range, evaluating the formulas
+             * of a rule incrementally.
+             *
+             * @param visit called with the range at each valuation and whether
+             * it is a counter-example, returning false to stop; the valuation
+             * is built only if the visitor asks the range for it
+             * */
+            template<typename Visitor>
+            void check_range(const PooledRule& rule, GenMatrixValuationRange& range, Visitor&& visit) const {
+                GenMatrixIncrementalEvaluator evaluator {rule.pool, range};
+                while (range.has_next()) {
+                    range.step();
+                    if (not visit(range, is_counter_example(evaluator.update(), rule)))
+                        return;
+                }
+            }
+
+            /* Backtracking search for counter-examples of a rule.
+             *
+             * Instead of enumerating every variable assignment together
+             * with every determinization of the interpretation, the nodes
+             * of the rule formulas are assigned in post-order: a variable
+             * takes each truth-value, and a compound node takes each
+             * image of the row selected by its children, the first time
+             * this row is needed (later uses of the row are then forced).
+             * A branch is cut as soon as all formulas of a premise are
+             * assigned without satisfying it, or a conclusion is satisfied.
+             * */
+            class CounterExampleSearch {
+
+                public:
+                    static constexpr int EMPTY = -1; //> empty image of a partial table
+                    static constexpr int UNSET = -2; //> row not determinized yet
+
+                    /* Values of the pool nodes and determinized
+                     * images of the used rows of each connective.
+                     * */
+                    struct Solution {
+                        std::vector<int> values;
+                        std::vector<std::vector<int>> choices;
+                    };
+
+                private:
+                    struct Occurrence {
+                        std::size_t sequent; //> index of the premise or conclusion
+                        bool premise;
+                        ValueMask dset; //> set of the position of the formula
+                    };
+
+                    const FormulaPool& _pool;
+                    int _nvalues;
+                    std::size_t _max_solutions;
+                    std::vector<std::shared_ptr<TruthTable<std::set<int>>>> _tables; //> by pool connective
+                    std::vector<std::vector<Occurrence>> _occurrences; //> by pool node
+                    std::vector<int> _remaining; //> unassigned formula occurrences of each premise
+                    std::vector<int> _witnesses; //> occurrences satisfying each premise
+                    std::vector<int> _values;
+                    std::vector<std::vector<int>> _choices;
+                    std::vector<Solution> _solutions;
+                    progresscpp::ProgressBar* _progress_bar = nullptr;
+
+                    bool satisfies(const Occurrence& o, int value) const {
+                        return value != EMPTY and not o.dset.contains(value);
+                    }
+
+                    /* Assign a value to a node.
+                     *
+                     * @return false if some premise or conclusion is now decided against a counter-example
+                     * */
+                    bool assign(std::size_t i, int value) {
+                        _values[i] = value;
+                        bool consistent = true;
+                        for (const auto& o : _occurrences[i]) {
+                            if (o.premise) {
+                                --_remaining[o.sequent];
+                                if (satisfies(o, value))
+                                    ++_witnesses[o.sequent];
+                                if (_remaining[o.sequent] == 0 and _witnesses[o.sequent] == 0)
+                                    consistent = false;
+                            } else if (satisfies(o, value))
+                                consistent = false;
+                        }
+                        return consistent;
+                    }
+
+                    void unassign(std::size_t i) {
+                        for (const auto& o : _occurrences[i]) {
+                            if (o.premise) {
+                                ++_remaining[o.sequent];
+                                if (satisfies(o, _values[i]))
+                                    --_witnesses[o.sequent];
+                            }
+                        }
+                    }
+
+                    bool branch(std::size_t i, int value) {
+                        bool stop = assign(i, value) and search(i + 1);
+                        unassign(i);
+                        if (i == 0 and _progress_bar != nullptr) {
+                            ++(*_progress_bar);
+                            _progress_bar->display();
+                        }
+                        return stop;
+                    }
+
+                    /* Explore the assignments of the nodes from the i-th on.
+                     *
+                     * @return true if enough solutions were found
+                     * */
+                    bool search(std::size_t i) {
+                        if (i == _pool.size()) {
+                            _solutions.push_back({_values, _choices});
+                            return _solutions.size() >= _max_solutions;
+                        }
+                        const auto& node = _pool.node(i);
+                        if (node.type == Formula::FmlaType::PROP) {
+                            for (int v = 0; v < _nvalues; ++v)
+                                if (branch(i, v))
+                                    return true;
+                            return false;
+                        }
+                        int row = 0;
+                        for (std::size_t k = 0; k < node.arity; ++k) {
+                            auto value = _values[_pool.child(i, k)];
+                            if (value == EMPTY)
+                                return branch(i, EMPTY);
+                            row = row * _nvalues + value;
+                        }
+                        auto& choice = _choices[node.symbol][row];
+                        if (choice != UNSET)
+                            return branch(i, choice);
+                        const auto& images = _tables[node.symbol]->image_at(row);
+                        bool stop = false;
+                        if (images.empty()) {
+                            choice = EMPTY;
+                            stop = branch(i, EMPTY);
+                        } else {
+                            for (auto v : images) {
+                                choice = v;
+                                if ((stop = branch(i, v)))
+                                    break;
+                            }
+                        }
+                        choice = UNSET;
+                        return stop;
+                    }
+
+                public:
+
+                    /* Constructor.
+                     *
+                     * @param pool the formulas of the rule
+                     * @param nvalues the number of truth-values
+                     * @param tables the interpretation of each connective of the pool
+                     * @param max_solutions the number of solutions after which the search stops
+                     * */
+                    CounterExampleSearch(const FormulaPool& pool, int nvalues,
+                            const decltype(_tables)& tables, std::size_t max_solutions)
+                        : _pool {pool}, _nvalues {nvalues}, _max_solutions {max_solutions},
+                          _tables {tables}, _occurrences (pool.size()), _values (pool.size(), UNSET) {
+                        for (const auto& table : _tables)
+                            _choices.emplace_back(table->number_of_rows(), UNSET);
+                    }
+
+                    /* Add a premise, which must hold in a solution.
+                     *
+                     * @param dsets the set of each position of the sequent
+                     * */
+                    void add_premise(const PooledSequent& seq, const std::vector<ValueMask>& dsets) {
+                        int occurrences = 0;
+                        for (std::size_t i = 0; i < seq.size(); ++i)
+                            for (auto node : seq[i]) {
+                                _occurrences[node].push_back({_remaining.size(), true, dsets[i]});
+                                ++occurrences;
+                            }
+                        _remaining.push_back(occurrences);
+                        _witnesses.push_back(0);
+                    }
+
+                    /* Add a conclusion, which must not hold in a solution.
+                     * */
+                    void add_conclusion(const PooledSequent& seq, const std::vector<ValueMask>& dsets, 
+                            std::size_t index) {
+                        for (std::size_t i = 0; i < seq.size(); ++i)
+                            for (auto node : seq[i])
+                                _occurrences[node].push_back({index, false, dsets[i]});
+                    }
+
+                    /* Run the search.
+                     *
+                     * @return the solutions found
+                     * */
+                    const std::vector<Solution>& run(progresscpp::ProgressBar* progress_bar = nullptr) {
+                        _solutions.clear();
+                        _progress_bar = progress_bar;
+                        if (_progress_bar != nullptr)
+                            _progress_bar->set_total_ticks(_nvalues);
+                        // a premise without formulas never holds
+                        if (std::find(_remaining.begin(), _remaining.end(), 0) == _remaining.end())
+                            search(0);
+                        return _solutions;
+                    }
+            };
+
+            /* The valuation of a solution of the search, the rows
+             * not determinized in it taking their first image.
+             * */
+            GenMatrixValuation to_valuation(const FormulaPool& pool, std::shared_ptr<Signature> sig_ptr,
+                    const typename CounterExampleSearch::Solution& solution) const {
+                using Search = CounterExampleSearch;
+                std::vector<std::pair<Prop, int>> mappings;
+                for (std::size_t i = 0; i < pool.size(); ++i)
+                    if (pool.node(i).type == Formula::FmlaType::PROP)
+                        mappings.push_back({pool.variables()[pool.node(i).symbol], solution.values[i]});
+                auto interp = std::make_shared<SignatureTruthInterp<std::set<int>>>(sig_ptr);
+                for (auto [symbol, connective] : *sig_ptr) {
+                    auto table = _matrix->interpretation()->get_interpretation(symbol)->truth_table();
+                    const std::vector<int>* choices = nullptr;
+                    for (std::size_t c = 0; c < pool.connectives().size(); ++c)
+                        if (pool.connectives()[c]->symbol_id() == connective->symbol_id())
+                            choices = &solution.choices[c];
+                    auto det = std::make_shared<TruthTable<std::set<int>>>(table->nvalues(), table->arity());
+                    for (int row = 0; row < table->number_of_rows(); ++row) {
+                        const auto& images = table->image_at(row);
+                        auto v = choices ? (*choices)[row] : Search::UNSET;
+                        if (v == Search::UNSET)
+                            v = images.empty() ? Search::EMPTY : *images.begin();
+                        det->set(row, v == Search::EMPTY ? std::set<int>{} : std::set<int>{v});
+                    }
+                    interp->try_interpret(std::make_shared<TruthInterp<std::set<int>>>(connective, det), true);
+                }
+                auto var_assignment = std::make_shared<GenMatrixVarAssignment>(_matrix, mappings);
+                return GenMatrixValuation{var_assignment, interp};
+            }
+
+            /* The interpretation of each connective of a pool.
+             * */
+            std::vector<std::shared_ptr<TruthTable<std::set<int>>>> pool_tables(const FormulaPool& pool) const {
+                std::vector<std::shared_ptr<TruthTable<std::set<int>>>> tables;
+                for (const auto& conn : pool.connectives())
+                    tables.push_back(_matrix->interpretation()->get_interpretation(conn->symbol_id())->truth_table());
+                return tables;
+            }
+
+            /* A uniform number below n, taken from the output of the
+             * generator alone, which the standard fixes for a given seed,
+             * unlike the algorithms of the standard distributions. The 
+             * outputs of the last incomplete block of n are rejected.
+             * */
+            static std::uint64_t draw_below(std::mt19937_64& generator, std::uint64_t n) {
+                const auto max = std::numeric_limits<std::uint64_t>::max();
+                const auto excess = (max % n + 1) % n; //> 2^64 mod n
+                std::uint64_t x;
+                do {
+                    x = generator();
+                } while (x > max - excess);
+                return x % n;
+            }
+
+            /* The sets of the positions of a sequent.
+             * */
+            std::vector<ValueMask> position_masks(const PooledSequent& seq) const {
+                std::vector<ValueMask> masks;
+                for (std::size_t i = 0; i < seq.size(); ++i)
+                    masks.push_back(_d_masks[_sequent_set_correspondence[i]]);
+                return masks;
+            }
     
         public:
             /**
@@ -831,6 +1865,20 @@ namespace ltsy {
                 CounterExample(decltype(val) _val) : val {_val} {}
             };
 
+            /**
+             * The outcome of testing a rule on random valuations.
+             * */
+            struct SamplingResult {
+                std::vector<CounterExample> counter_examples;
+                unsigned long long samples = 0; //> number of valuations drawn
+                double confidence = 0.95;
+                /* When no counter-example was found, an upper bound, holding
+                 * with the confidence above, on the fraction of the valuations
+                 * that are counter-examples.
+                 * */
+                std::optional<double> max_counter_example_rate;
+            };
+
             /* Constructor.
              *
              * @param matrix pointer to generalized matrix
@@ -844,6 +1892,8 @@ namespace ltsy {
                     const decltype(_sequent_set_correspondence)& sequent_set_correspondence) :
                _matrix {matrix}, _sequent_set_correspondence {sequent_set_correspondence} {
                    _d_sets = matrix->distinguished_sets();
+                   for (const auto& dset : _d_sets)
+                       _d_masks.emplace_back(dset);
             }
 
             /* Given a variable assignment, determines
@@ -854,13 +1904,21 @@ namespace ltsy {
              * @author Vitor Greati
              * */
             std::optional<std::set<std::shared_ptr<Formula>>>
-            is_fmla_set_valid_under_valuation(const GenMatrixValuation val, 
+            is_fmla_set_valid_under_valuation(const GenMatrixValuation& val, 
                             const FmlaSet& fmls, const std::set<int>& dset) const {
+                GenMatrixEvaluator evaluator {val};
+                return is_fmla_set_valid_under_valuation(evaluator, fmls, ValueMask {dset});
+            }
+
+            /* Same as above, evaluating the formulas with the given
+             * evaluator, which memoizes the values of the subformulas.
+             * */
+            std::optional<std::set<std::shared_ptr<Formula>>>
+            is_fmla_set_valid_under_valuation(GenMatrixEvaluator& evaluator, 
+                            const FmlaSet& fmls, ValueMask dset) const {
                 std::set<std::shared_ptr<Formula>> fail_fmls;
                 for (const auto& f : fmls) {
-                   GenMatrixEvaluator collector {std::make_shared<GenMatrixValuation>(val)};
-                   auto fmla_values = f->accept(collector);     
-                   if (!utils::is_subset(fmla_values, dset))
+                   if (not evaluator.evaluate_mask(f).is_subset_of(dset))
                        fail_fmls.insert(f);
                 }
                 if (fail_fmls.empty()) return std::nullopt;
@@ -869,13 +1927,40 @@ namespace ltsy {
 
             bool
             is_valid_under_valuation(const GenMatrixValuation& val, const NdSequent<FmlaContainerT>& seq) const {
+                GenMatrixEvaluator evaluator {val};
+                return is_valid_under_valuation(evaluator, seq);
+            }
+
+            /* Same as above, evaluating the formulas with the given
+             * evaluator, so that the values of the subformulas are 
+             * shared among positions and sequents.
+             * */
+            bool
+            is_valid_under_valuation(GenMatrixEvaluator& evaluator, const NdSequent<FmlaContainerT>& seq) const {
                  for (int i {0}; i < seq.dimension(); ++i) {
-                     auto is_model_result = is_fmla_set_valid_under_valuation(val, seq[i], _d_sets[_sequent_set_correspondence[i]]);
-                     if (is_model_result) return true;
+                     auto dset = _d_masks[_sequent_set_correspondence[i]];
+                     for (const auto& f : seq[i])
+                         if (not evaluator.evaluate_mask(f).is_subset_of(dset))
+                             return true;
                  }
                  return false;
             }
 
+            /* Whether a valuation satisfies all premises of a rule 
+             * but none of its conclusions, evaluating each distinct
+             * subformula of the rule once.
+             * */
+            bool is_counter_example(const GenMatrixValuation& val, const NdSequentRule<FmlaContainerT>& rule) const {
+                GenMatrixEvaluator evaluator {val};
+                for (const auto& p : rule.premises())
+                    if (not is_valid_under_valuation(evaluator, p))
+                        return false;
+                for (const auto& c : rule.conclusions())
+                    if (is_valid_under_valuation(evaluator, c))
+                        return false;
+                return true;
+            }
+
 
             /* Test if a rule preserves satisfaction under
              * every possible valuation (aka rule soundness).
@@ -889,55 +1974,72 @@ namespace ltsy {
 
             /* Test if a rule preserves satisfaction under
              * every possible valuation (aka rule soundness).
+             *
+             * @param threads the number of threads checking the
+             * valuations; with more than one, the counter-examples
+             * given are not necessarily the first ones
+             * @param cache if given, its valuations are tried first, and
+             * the counter-examples found are stored in it
              * */
             std::optional<std::vector<CounterExample>>
             is_rule_satisfiability_preserving(
                     const NdSequentRule<FmlaContainerT>& rule, 
                     const Signature& sig,
                     int max_counter_examples=1,
-                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt) const { 
+                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt,
+                    int threads = 1,
+                    GenMatrixCounterExampleCache* cache = nullptr) const { 
                 std::vector<CounterExample> counter_examples;
                 auto props_set = rule.collect_props();
                 std::vector<std::shared_ptr<Prop>> props {props_set.begin(), props_set.end()};
-                ltsy::GenMatrixValuationGenerator generator {_matrix, props, std::make_shared<Signature>(sig)};
-                spdlog::debug(generator.total());
-                if (generator.total() >= (1 << 22)) {
-                    spdlog::warn("Rule avoided, too many valuations to test");
-                    throw std::logic_error("Too many valuations to test");
-                }
-                //spdlog::debug("Valuations to test: " + std::to_string(generator.total()));
-                if (progress_bar)
-                    (*progress_bar).set_total_ticks(generator.total());
-                while (generator.has_next()) {
-                    auto val = generator.next();
-                    // update progress
-                    if (progress_bar) {
-                        ++(*progress_bar);
-                        (*progress_bar).display();
-                    }
-                    // check validity of premises
-                    bool premises_valid = true;
-                    for (const auto& p : rule.premises()) {
-                        if (not is_valid_under_valuation(*val, p)) {
-                            premises_valid = false;
-                            break;
-                        }
+                auto sig_ptr = std::make_shared<Signature>(sig);
+                if (cache != nullptr) {
+                    for (const auto& val : cache->candidates(_matrix, props, sig_ptr))
+                        if (counter_examples.size() < max_counter_examples and is_counter_example(val, rule))
+                            counter_examples.push_back(CounterExample{val});
+                    if (not counter_examples.empty() and counter_examples.size() >= max_counter_examples) {
+                        spdlog::debug("Refuted by stored counter-examples");
+                        return std::make_optional<std::vector<CounterExample>>(counter_examples);
                     }
-                    // check non-validity of conclusions
-                    bool conclusions_not_valid = true;
-                    if (premises_valid) {
-                        for (const auto& c : rule.conclusions()) {
-                            if (is_valid_under_valuation(*val, c)) {
-                                conclusions_not_valid = false;
-                                break;
-                            }
+                    auto checked = is_rule_satisfiability_preserving(rule, sig, max_counter_examples, 
+                            progress_bar, threads);
+                    if (checked)
+                        for (const auto& ce : *checked)
+                            cache->add(props, ce.val);
+                    return checked;
+                }
+                auto pooled = add_to_pool(rule);
+                // only the rows reachable by the rule formulas under each
+                // variable assignment are determinized in every way
+                const GenMatrixValuationRange::Index max_valuations = 1 << 22;
+                std::optional<GenMatrixValuationRange> relevant;
+                if (std::pow(_matrix->values().size(), props.size()) < max_valuations) {
+                    relevant.emplace(_matrix, props, sig_ptr, pooled.pool);
+                    spdlog::debug(relevant->total());
+                }
+                if (not relevant or relevant->total() >= max_valuations) {
+                    spdlog::debug("Too many valuations to enumerate, searching instead");
+                    return search_counter_examples(rule, sig, max_counter_examples, progress_bar);
+                }
+                // the valuations are visited in Gray order, so that only the 
+                // subformulas affected by each change are evaluated again
+                if (threads > 1) {
+                    counter_examples = check_in_parallel(pooled, *relevant, 
+                            max_counter_examples, threads, progress_bar);
+                } else {
+                    auto& range = *relevant;
+                    if (progress_bar)
+                        (*progress_bar).set_total_ticks(range.total());
+                    check_range(pooled, range, [&](auto& current, bool is_counter_example) {
+                        // update progress
+                        if (progress_bar) {
+                            ++(*progress_bar);
+                            (*progress_bar).display();
                         }
-                    }
-                    if (premises_valid and conclusions_not_valid) {
-                        counter_examples.push_back(CounterExample{*(val->copy())});
-                    }
-                    if (counter_examples.size() >= max_counter_examples)
-                        break;
+                        if (is_counter_example)
+                            counter_examples.push_back(CounterExample{*(current.valuation()->copy())});
+                        return counter_examples.size() < max_counter_examples;
+                    });
                 }
                 if (progress_bar)
                     (*progress_bar).done();
@@ -946,6 +2048,194 @@ namespace ltsy {
                 else
                     return std::make_optional<std::vector<CounterExample>>(counter_examples);
             }
+
+            /* Test rule soundness by a backtracking search over the
+             * subformulas of the rule, which only determinizes the rows 
+             * of the tables actually reached, instead of enumerating 
+             * all valuations. The rows not reached are determinized
+             * to their first image in the counter-examples, hence
+             * counter-examples differing only in such rows are
+             * given once.
+             * */
+            std::optional<std::vector<CounterExample>>
+            search_counter_examples(
+                    const NdSequentRule<FmlaContainerT>& rule, 
+                    const Signature& sig,
+                    int max_counter_examples=1,
+                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt) const { 
+                // premises come first in the pool, so that they are decided earlier
+                auto [pool, premises, conclusions] = add_to_pool(rule);
+                CounterExampleSearch search {pool, static_cast<int>(_matrix->values().size()), pool_tables(pool), 
+                    static_cast<std::size_t>(std::max(max_counter_examples, 1))};
+                for (const auto& p : premises)
+                    search.add_premise(p, position_masks(p));
+                for (std::size_t i = 0; i < conclusions.size(); ++i)
+                    search.add_conclusion(conclusions[i], position_masks(conclusions[i]), i);
+                const auto& solutions = search.run(progress_bar ? &(*progress_bar) : nullptr);
+                if (progress_bar)
+                    (*progress_bar).done();
+                if (solutions.empty())
+                    return std::nullopt;
+                // build the valuations of the solutions
+                auto sig_ptr = std::make_shared<Signature>(sig);
+                std::vector<CounterExample> counter_examples;
+                for (const auto& solution : solutions)
+                    counter_examples.push_back(CounterExample{to_valuation(pool, sig_ptr, solution)});
+                return std::make_optional<std::vector<CounterExample>>(counter_examples);
+            }
+
+            /* Test a rule on valuations drawn uniformly at random, for
+             * refuting rules whose valuations are too many to check.
+             *
+             * A valuation is drawn by taking a random value for each
+             * variable and a random image for each row of the tables the
+             * first time the rule formulas reach it, which amounts to
+             * unranking a uniform index of the valuations, without ever
+             * fixing the rows not reached. Counter-examples drawn
+             * more than once are given once. The valuations drawn
+             * for a seed are the same on every platform.
+             *
+             * @param samples the number of valuations to draw
+             * @param seed the seed of the random generator, so that runs are reproducible
+             * @param confidence the confidence of the bound given when no
+             * counter-example is found
+             * */
+            SamplingResult sample_counter_examples(
+                    const NdSequentRule<FmlaContainerT>& rule, 
+                    const Signature& sig,
+                    unsigned long long samples,
+                    std::uint64_t seed = 0,
+                    int max_counter_examples=1,
+                    double confidence = 0.95,
+                    std::optional<progresscpp::ProgressBar> progress_bar = std::nullopt) const { 
+                if (confidence <= 0 or confidence >= 1)
+                    throw std::invalid_argument("The confidence must be strictly between 0 and 1.");
+                using Search = CounterExampleSearch;
+                auto pooled = add_to_pool(rule);
+                const auto& pool = pooled.pool;
+                const int nvalues = _matrix->values().size();
+                auto tables = pool_tables(pool);
+                std::mt19937_64 generator {seed};
+                typename Search::Solution sample;
+                sample.values.resize(pool.size());
+                for (const auto& table : tables)
+                    sample.choices.emplace_back(table->number_of_rows(), Search::UNSET);
+                std::vector<std::pair<int, int>> chosen; //> rows determinized in the current sample
+                std::vector<ValueMask> values (pool.size());
+                std::vector<typename Search::Solution> solutions;
+                SamplingResult result;
+                result.confidence = confidence;
+                if (progress_bar)
+                    (*progress_bar).set_total_ticks(samples);
+                const auto max_solutions = static_cast<std::size_t>(std::max(max_counter_examples, 1));
+                while (result.samples < samples and solutions.size() < max_solutions) {
+                    for (auto [symbol, row] : chosen)
+                        sample.choices[symbol][row] = Search::UNSET;
+                    chosen.clear();
+                    // the pool is in post-order, so the children come first
+                    for (std::size_t i = 0; i < pool.size(); ++i) {
+                        const auto& node = pool.node(i);
+                        auto& value = sample.values[i];
+                        if (node.type == Formula::FmlaType::PROP) {
+                            value = draw_below(generator, nvalues);
+                        } else {
+                            int row = 0;
+                            for (std::size_t k = 0; k < node.arity and row != Search::EMPTY; ++k) {
+                                auto child = sample.values[pool.child(i, k)];
+                                row = child == Search::EMPTY ? Search::EMPTY : row * nvalues + child;
+                            }
+                            if (row == Search::EMPTY) {
+                                value = Search::EMPTY;
+                            } else if ((value = sample.choices[node.symbol][row]) == Search::UNSET) {
+                                const auto& images = tables[node.symbol]->image_at(row);
+                                value = Search::EMPTY;
+                                if (not images.empty()) {
+                                    value = *std::next(images.begin(), draw_below(generator, images.size()));
+                                }
+                                sample.choices[node.symbol][row] = value;
+                                chosen.push_back({node.symbol, row});
+                            }
+                        }
+                        values[i] = value == Search::EMPTY ? ValueMask{} : ValueMask::singleton(value);
+                    }
+                    ++result.samples;
+                    if (progress_bar) {
+                        ++(*progress_bar);
+                        (*progress_bar).display();
+                    }
+                    if (is_counter_example(values, pooled) 
+                            and std::none_of(solutions.begin(), solutions.end(), [&](const auto& s) {
+                                return s.values == sample.values and s.choices == sample.choices; }))
+                        solutions.push_back(sample);
+                }
+                if (progress_bar)
+                    (*progress_bar).done();
+                auto sig_ptr = std::make_shared<Signature>(sig);
+                for (const auto& solution : solutions)
+                    result.counter_examples.push_back(CounterExample{to_valuation(pool, sig_ptr, solution)});
+                // if a fraction p of the valuations were counter-examples, missing
+                // all of them in n samples would have probability (1-p)^n
+                if (solutions.empty() and result.samples > 0)
+                    result.max_counter_example_rate = 1 - std::pow(1 - confidence, 1.0 / result.samples);
+                return result;
+            }
+
+        private:
+
+            /* Check the valuations of a rule by several threads, each one
+             * taking the next unchecked range of indices. The threads share
+             * the budget of counter-examples, all stopping once it is spent.
+             * */
+            std::vector<CounterExample> check_in_parallel(const PooledRule& rule,
+                    const GenMatrixValuationRange& valuations,
+                    int max_counter_examples, int threads,
+                    std::optional<progresscpp::ProgressBar>& progress_bar) const {
+                using Index = GenMatrixValuationRange::Index;
+                const Index total = valuations.total();
+                // more ranges than threads, to balance the work
+                const Index nranges = std::min<Index>(total, static_cast<Index>(threads) * 16);
+                if (progress_bar)
+                    (*progress_bar).set_total_ticks(nranges);
+                std::vector<CounterExample> counter_examples;
+                std::atomic<Index> next_range {0};
+                std::atomic<int> budget {max_counter_examples};
+                std::exception_ptr error;
+                std::mutex mutex;
+                auto worker = [&]() {
+                    try {
+                        for (auto r = next_range++; r < nranges and budget > 0; r = next_range++) {
+                            auto range = valuations.slice(
+                                total / nranges * r + std::min(r, total % nranges),
+                                total / nranges * (r + 1) + std::min(r + 1, total % nranges));
+                            check_range(rule, range, [&](auto& current, bool is_counter_example) {
+                                if (is_counter_example and budget-- > 0) {
+                                    std::lock_guard<std::mutex> lock {mutex};
+                                    counter_examples.push_back(CounterExample{*(current.valuation()->copy())});
+                                }
+                                return budget > 0;
+                            });
+                            if (progress_bar) {
+                                std::lock_guard<std::mutex> lock {mutex};
+                                ++(*progress_bar);
+                                (*progress_bar).display();
+                            }
+                        }
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock {mutex};
+                        if (not error)
+                            error = std::current_exception();
+                        budget = 0;
+                    }
+                };
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; ++t)
+                    workers.emplace_back(worker);
+                for (auto& w : workers)
+                    w.join();
+                if (error)
+                    std::rethrow_exception(error);
+                return counter_examples;
+            }
     };
 
 };
@@ -1,9 +1,14 @@
 #ifndef __NMATRICES__
 #define __NMATRICES__
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
 #include <set>
 #include "core/syntax.h"
 #include "core/combinatorics/combinations.h"
+#include "core/combinatorics/permutations.h"
 #include "core/semantics/truth_tables.h"
 #include "core/common.h"
 
@@ -28,8 +33,68 @@ namespace ltsy {
             std::shared_ptr<Connective> _connective; //< a pointer to the connective
             std::shared_ptr<TruthTable<CellType>> _truth_table; //< a pointer to the truth table
 
+            /* The table lifted to sets of values: the image of
+             * a tuple of bitmasks (M1,...,Mk) at the position
+             * M1 * 2^(n(k-1)) + ... + Mk.
+             * */
+            struct LiftedTable {
+                const TruthTable<CellType>* table; //> the truth table it was built from
+                std::uint64_t version; //> the version of the table
+                std::vector<ValueMask> images;
+            };
+            mutable std::shared_ptr<const LiftedTable> _lifted;
+
+            std::shared_ptr<const LiftedTable> build_lifted_table() const {
+                auto nvalues = _truth_table->nvalues();
+                auto arity = _truth_table->arity();
+                if (nvalues * arity > MAX_LIFTED_BITS)
+                    throw std::logic_error("Truth table too large to be lifted.");
+                auto lifted = std::make_shared<LiftedTable>();
+                lifted->table = _truth_table.get();
+                lifted->version = _truth_table->version();
+                lifted->images.resize(std::size_t(1) << (nvalues * arity));
+                const std::size_t base = std::size_t(1) << nvalues;
+                std::vector<std::uint64_t> masks (arity);
+                for (std::size_t index = 0; index < lifted->images.size(); ++index) {
+                    auto rest = index;
+                    for (int k = arity - 1; k >= 0; --k, rest /= base)
+                        masks[k] = rest % base;
+                    if (std::find(masks.begin(), masks.end(), 0) != masks.end())
+                        continue;
+                    // split the first non-singleton mask into its lowest bit 
+                    // and the remaining ones, whose images come earlier
+                    std::size_t weight = lifted->images.size();
+                    int split = -1;
+                    for (int k = 0; k < arity and split == -1; ++k) {
+                        weight /= base;
+                        if (masks[k] & (masks[k] - 1))
+                            split = k;
+                    }
+                    if (split == -1) {
+                        int row = 0;
+                        for (int k = 0; k < arity; ++k)
+                            row = row * nvalues + __builtin_ctzll(masks[k]);
+                        lifted->images[index] = ValueMask {_truth_table->image_at(row)};
+                    } else {
+                        auto low = masks[split] & -masks[split];
+                        lifted->images[index] = lifted->images[index - (masks[split] - low) * weight]
+                            | lifted->images[index - low * weight];
+                    }
+                }
+                return lifted;
+            }
+
         public:
 
+            /* Maximum number of bits of a position of a lifted table,
+             * that is, of values times arity.
+             * */
+            static constexpr std::size_t MAX_LIFTED_BITS = 16;
+
+            /* Maximum number of positions of a lifted table.
+             * */
+            static constexpr std::size_t MAX_LIFTED_SIZE = std::size_t(1) << MAX_LIFTED_BITS;
+
             /* Construct a truth interpretation for a connective.
              * */
             TruthInterp(decltype(_connective) connective,
@@ -68,6 +133,29 @@ namespace ltsy {
                 return _truth_table->at(args);
             }
 
+            /* The union of the images of every input whose i-th argument
+             * is in args[i]. When the table lifted to sets of values
+             * is small enough, it is built on the first call (and again
+             * after the table changes) and this is a single lookup.
+             * */
+            ValueMask image(const std::vector<ValueMask>& args) const {
+                auto nvalues = _truth_table->nvalues();
+                if (args.size() != _truth_table->arity() 
+                        or nvalues * args.size() > MAX_LIFTED_BITS)
+                    return _truth_table->image(args);
+                auto lifted = std::atomic_load(&_lifted);
+                if (lifted == nullptr or lifted->table != _truth_table.get() 
+                        or lifted->version != _truth_table->version()) {
+                    lifted = build_lifted_table();
+                    std::atomic_store(&_lifted, lifted);
+                }
+                auto all = ValueMask::all(nvalues).bits();
+                std::size_t index = 0;
+                for (const auto& a : args)
+                    index = (index << nvalues) | (a.bits() & all);
+                return lifted->images[index];
+            }
+
             friend std::ostream& operator<<(std::ostream& os, const TruthInterp<CellType>& ti) {
                 os << ti._connective->symbol();
                 os << std::string(":") << std::endl;
@@ -139,12 +227,25 @@ namespace ltsy {
         private:
             std::shared_ptr<Signature> _signature;
             std::map<Symbol, std::shared_ptr<TruthInterp<CellType>>> _truth_interps;
+            //> Same interpretations, indexed by connective symbol id
+            std::vector<std::shared_ptr<TruthInterp<CellType>>> _truth_interps_by_id;
+
+            void index_interpretation(std::shared_ptr<TruthInterp<CellType>> truth_interp) {
+                auto id = truth_interp->connective()->symbol_id();
+                if (id >= _truth_interps_by_id.size())
+                    _truth_interps_by_id.resize(id + 1);
+                _truth_interps_by_id[id] = truth_interp;
+            }
+
         public:
             SignatureTruthInterp(decltype(_signature) signature)
                 : _signature {signature} {/* empty */}
 
             SignatureTruthInterp(decltype(_signature) signature, const decltype(_truth_interps)& truth_interps)
-                : _signature {signature}, _truth_interps {truth_interps} {/* empty */}
+                : _signature {signature}, _truth_interps {truth_interps} {
+                for (const auto& [s, ti] : _truth_interps)
+                    index_interpretation(ti);
+            }
 
             SignatureTruthInterp(decltype(_signature) signature, 
                     std::initializer_list<std::shared_ptr<TruthInterp<CellType>>> _interps)
@@ -183,6 +284,7 @@ namespace ltsy {
                         else
                             throw std::invalid_argument(CONNECTIVE_ALREADY_INTERP_EXCEPTION);
                     }
+                    index_interpretation(truth_interp);
                 } catch (ConnectiveNotPresentException e) {
                     throw; 
                 }
@@ -192,8 +294,85 @@ namespace ltsy {
                 return this->_truth_interps.at(symbol);
             }
 
+            /* Get the interpretation of a connective by its symbol id.
+             * */
+            const std::shared_ptr<TruthInterp<CellType>>& get_interpretation(SymbolId id) const {
+                if (id >= _truth_interps_by_id.size() or _truth_interps_by_id[id] == nullptr)
+                    throw std::out_of_range("connective not interpreted");
+                return _truth_interps_by_id[id];
+            }
+
             decltype(_signature) signature() const {return _signature; }
 
+            /* The interpretation isomorphic to this one by
+             * the renaming of each value v by sigma[v].
+             * */
+            std::shared_ptr<SignatureTruthInterp> permuted(const std::vector<int>& sigma) const {
+                decltype(_truth_interps) truth_interps;
+                for (const auto& [s, ti] : _truth_interps) {
+                    auto tt = std::make_shared<TruthTable<CellType>>(*ti->truth_table());
+                    auto images = tt->permuted_images(sigma);
+                    for (int i = 0; i < images.size(); ++i)
+                        tt->set(i, images[i]);
+                    truth_interps[s] = std::make_shared<TruthInterp<CellType>>(ti->connective(), tt);
+                }
+                return std::make_shared<SignatureTruthInterp>(_signature, truth_interps);
+            }
+
+            /* Compare the interpretation renamed by sigma with this
+             * one, connective by connective in the order of their
+             * symbols, and row by row.
+             *
+             * @return negative if the renamed interpretation precedes
+             *         this one, zero if they are equal, positive otherwise
+             * */
+            int compare_permuted(const std::vector<int>& sigma) const {
+                for (const auto& [s, ti] : _truth_interps) {
+                    const auto& tt = *ti->truth_table();
+                    auto images = tt.permuted_images(sigma);
+                    for (int i = 0; i < images.size(); ++i)
+                        if (images[i] != tt.image_at(i))
+                            return images[i] < tt.image_at(i) ? -1 : 1;
+                }
+                return 0;
+            }
+
+            /* Check if the interpretation precedes another one
+             * of the same signature, in the order of compare_permuted.
+             * */
+            bool precedes(const SignatureTruthInterp& other) const {
+                for (const auto& [s, ti] : _truth_interps) {
+                    const auto& tt = *ti->truth_table();
+                    const auto& other_tt = *other._truth_interps.at(s)->truth_table();
+                    if (tt < other_tt) return true;
+                    if (other_tt < tt) return false;
+                }
+                return false;
+            }
+
+            /* Check if the interpretation is the least in its
+             * orbit by a group of permutations of the values.
+             *
+             * @param permutations the group, without the identity
+             * */
+            bool is_canonical(const std::vector<std::vector<int>>& permutations) const {
+                for (const auto& sigma : permutations)
+                    if (compare_permuted(sigma) < 0)
+                        return false;
+                return true;
+            }
+
+            /* The permutations among the given ones that
+             * fix the interpretation.
+             * */
+            std::vector<std::vector<int>> stabilizer(const std::vector<std::vector<int>>& permutations) const {
+                std::vector<std::vector<int>> result;
+                for (const auto& sigma : permutations)
+                    if (compare_permuted(sigma) == 0)
+                        result.push_back(sigma);
+                return result;
+            }
+
             friend std::ostream& operator<<(std::ostream& os, const SignatureTruthInterp<CellType>& ti) {
                 for(auto& [s, t] : ti._truth_interps) {
                     os << (*t) << std::endl;
@@ -216,6 +395,16 @@ namespace ltsy {
             }
     };
 
+    /**
+     * Generator of the interpretations of a signature.
+     *
+     * Optionally, only one representative of each class of
+     * isomorphic interpretations is generated, namely the least
+     * one in the orbit by the permutations of the values
+     * (or by those fixing a given set of values).
+     *
+     * @author Vitor Greati
+     * */
     class SignatureTruthInterpGenerator {
 
         private:
@@ -224,6 +413,10 @@ namespace ltsy {
             std::map<Symbol, TruthInterpGenerator> _generators;
             int _nvalues;
             std::shared_ptr<SignatureTruthInterp<int>> _current;
+            std::shared_ptr<SignatureTruthInterp<int>> _raw; //> Position of the generators
+            bool _up_to_isomorphism = false;
+            std::vector<std::vector<int>> _permutations;
+            std::shared_ptr<SignatureTruthInterp<int>> _lookahead; //> Next canonical interpretation
 
             void initialize_generators() {
                 for (auto [symbol, connective] : (*_signature)) {
@@ -238,14 +431,61 @@ namespace ltsy {
                     std::cout << "interpreting " << symbol << std::endl;
                     sti->try_interpret(gen.next());
                 }
-                (*(_generators.begin())).second.reset();
                 return sti;
             }
+
+            bool can_advance() {
+                for (auto& [s, g] : _generators) {
+                    if (g.has_next()) 
+                        return true;
+                }
+                return false;
+            }
+
+            /* Move the generators to the next interpretation,
+             * leaving the previous ones untouched.
+             * */
+            void advance() {
+                _raw = std::make_shared<SignatureTruthInterp<int>>(*_raw);
+                for (auto& [symbol, generator] : _generators) {
+                    if (generator.has_next()) {
+                        auto tt = generator.next();
+                        _raw->try_interpret(tt, true);
+                        break;
+                    } 
+                    generator.reset();
+                    _raw->try_interpret(generator.next(), true);
+                }
+            }
+
+            void find_canonical() {
+                _lookahead = nullptr;
+                while (can_advance()) {
+                    advance();
+                    if (_raw->is_canonical(_permutations)) {
+                        _lookahead = _raw;
+                        return;
+                    }
+                }
+            }
     
         public:
 
-            SignatureTruthInterpGenerator(int nvalues, decltype(_signature) signature) 
-                : _signature {signature}, _nvalues {nvalues} {
+            /* Generator of the interpretations of a signature.
+             *
+             * @param nvalues the number of values
+             * @param signature the signature
+             * @param up_to_isomorphism if only the canonical interpretations
+             *        must be generated
+             * @param preserved if present, only the permutations mapping
+             *        this set onto itself are considered isomorphisms
+             * */
+            SignatureTruthInterpGenerator(int nvalues, decltype(_signature) signature,
+                    bool up_to_isomorphism = false,
+                    const std::optional<std::set<int>>& preserved = std::nullopt) 
+                : _signature {signature}, _nvalues {nvalues}, _up_to_isomorphism {up_to_isomorphism} {
+                if (_up_to_isomorphism)
+                    _permutations = value_permutations(nvalues, preserved);
                 initialize_generators();    
                 reset();
             }
@@ -253,33 +493,36 @@ namespace ltsy {
             decltype(_current) next() {
                 if (not has_next())
                     throw std::logic_error("no truth interpretation available");
-
-                for (auto& [symbol, generator] : _generators) {
-                    if (generator.has_next()) {
-                        auto tt = generator.next();
-                        _current->try_interpret(tt, true);
-                        break;
-                    } 
-                    generator.reset();
-                    _current->try_interpret(generator.next(), true);
+                if (_up_to_isomorphism) {
+                    _current = _lookahead;
+                    find_canonical();
+                } else {
+                    advance();
+                    _current = _raw;
                 }
                 return _current;
             }
 
             decltype(_current) current() { return _current; }
 
+            /* The permutations of values considered as
+             * isomorphisms, without the identity.
+             * */
+            const decltype(_permutations)& permutations() const { return _permutations; }
+
             void reset() {
                 for (auto& [s, g] : _generators)
                     g.reset();
-                _current = truth_interp_from_generators();
+                _raw = truth_interp_from_generators();
+                _current = _raw;
+                if (_up_to_isomorphism)
+                    find_canonical();
             }
 
             bool has_next() {
-                for (auto& [s, g] : _generators) {
-                    if (g.has_next()) 
-                        return true;
-                }
-                return false;
+                if (_up_to_isomorphism)
+                    return _lookahead != nullptr;
+                return can_advance();
             }
     
     };
@@ -317,6 +560,52 @@ namespace ltsy {
              
             inline decltype(_signature) signature() const { return _signature; }
 
+            /* The matrix isomorphic to this one by
+             * the renaming of each value v by sigma[v].
+             * */
+            std::shared_ptr<NMatrix> permuted(const std::vector<int>& sigma) const {
+                return std::make_shared<NMatrix>(_nvalues, permute_values(_dvalues, sigma),
+                        _signature, _interpretation->permuted(sigma));
+            }
+
+            /* Order matrices by their interpretations, 
+             * then by their designated values.
+             * */
+            bool precedes(const NMatrix& other) const {
+                if (_interpretation->precedes(*other._interpretation)) return true;
+                if (other._interpretation->precedes(*_interpretation)) return false;
+                return _dvalues < other._dvalues;
+            }
+
+            /* Check if the matrix is the least in its orbit
+             * by a group of permutations of the values.
+             *
+             * @param permutations the group, without the identity
+             * */
+            bool is_canonical(const std::vector<std::vector<int>>& permutations) const {
+                for (const auto& sigma : permutations) {
+                    auto comparison = _interpretation->compare_permuted(sigma);
+                    if (comparison < 0 or (comparison == 0 and permute_values(_dvalues, sigma) < _dvalues))
+                        return false;
+                }
+                return true;
+            }
+
+            /* The canonical form of the matrix: the least matrix
+             * isomorphic to it by a group of permutations of the values.
+             *
+             * @param permutations the group, without the identity
+             * */
+            std::shared_ptr<NMatrix> canonical_form(const std::vector<std::vector<int>>& permutations) const {
+                auto result = std::make_shared<NMatrix>(*this);
+                for (const auto& sigma : permutations) {
+                    auto candidate = permuted(sigma);
+                    if (candidate->precedes(*result))
+                        result = candidate;
+                }
+                return result;
+            }
+
             friend std::ostream& operator<<(std::ostream& os, const NMatrix& nm) {
                 os << std::string("<");
                 os << nm.nvalues();
@@ -331,6 +620,10 @@ namespace ltsy {
     /**
      * A generator of NMatrices.
      *
+     * Optionally, only one representative of each class of
+     * isomorphic matrices is generated: the interpretations are
+     * generated up to isomorphism, and each is paired only with the
+     * designated sets that are least under the permutations fixing it.
      * */
     class NMatrixGenerator {
 
@@ -341,38 +634,66 @@ namespace ltsy {
             std::shared_ptr<CombinationGenerator> _combination_gen;
             std::shared_ptr<SignatureTruthInterpGenerator> _sig_truth_int_gen;
             std::shared_ptr<NMatrix> _current;
+            bool _up_to_isomorphism = false;
+            std::vector<std::vector<int>> _stabilizer; //> Permutations fixing the current interpretation
+            std::shared_ptr<NMatrix> _lookahead; //> Next canonical matrix
 
             std::set<int> _vec_to_set(std::shared_ptr<std::vector<int>> vec) {
                 return std::set<int>(vec->begin(), vec->end());
             }
 
+            bool can_advance() {
+                return _sig_truth_int_gen->has_next() or _combination_gen->has_next();
+            }
+
+            decltype(_current) advance() {
+                if (not _combination_gen->has_next()) {
+                    _combination_gen->reset();
+                    auto next_sig_truth_int = _sig_truth_int_gen->next();
+                    if (_up_to_isomorphism)
+                        _stabilizer = next_sig_truth_int->stabilizer(_sig_truth_int_gen->permutations());
+                }
+                return std::make_shared<NMatrix>(_nvalues,
+                                                 _vec_to_set(_combination_gen->next()),
+                                                 _signature,
+                                                 _sig_truth_int_gen->current());
+            }
+
+            void find_canonical() {
+                _lookahead = nullptr;
+                while (can_advance()) {
+                    auto candidate = advance();
+                    bool least = true;
+                    for (auto it = _stabilizer.begin(); least and it != _stabilizer.end(); ++it)
+                        least = not (permute_values(candidate->dvalues(), *it) < candidate->dvalues());
+                    if (least) {
+                        _lookahead = candidate;
+                        return;
+                    }
+                }
+            }
+
         public:
 
-            NMatrixGenerator(int nvalues, decltype(_signature) signature)
-                : _nvalues {nvalues}, _signature {signature} {
+            NMatrixGenerator(int nvalues, decltype(_signature) signature, bool up_to_isomorphism = false)
+                : _nvalues {nvalues}, _signature {signature}, _up_to_isomorphism {up_to_isomorphism} {
                 _combination_gen = std::make_shared<DiscretureCombinationGenerator>(nvalues);    
-                _sig_truth_int_gen = std::make_shared<SignatureTruthInterpGenerator>(nvalues, _signature);
+                _sig_truth_int_gen = std::make_shared<SignatureTruthInterpGenerator>(nvalues, _signature,
+                        up_to_isomorphism);
+                if (_up_to_isomorphism) {
+                    _stabilizer = _sig_truth_int_gen->current()->stabilizer(_sig_truth_int_gen->permutations());
+                    find_canonical();
+                }
             }
 
             decltype(_current) next() {
                 if (not has_next())
                     throw std::logic_error("no next nmatrix to generate");
-                if (_combination_gen->has_next()) {
-                    auto next_comb = _combination_gen->next();
-                    return std::make_shared<NMatrix>(_nvalues,
-                                                     _vec_to_set(next_comb),
-                                                     _signature,
-                                                     _sig_truth_int_gen->current());
-
-                } else {
-                    _combination_gen->reset();
-                    auto next_sig_truth_int = _sig_truth_int_gen->next();
-                    return std::make_shared<NMatrix>(_nvalues,
-                            _vec_to_set(_combination_gen->first()),
-                            _signature,
-                            next_sig_truth_int);
-                }
-            
+                if (not _up_to_isomorphism)
+                    return advance();
+                auto result = _lookahead;
+                find_canonical();
+                return result;
             }
 
             decltype(_current) first() {
@@ -383,7 +704,9 @@ namespace ltsy {
             }
             
             bool has_next() {
-                return _sig_truth_int_gen->has_next() or _combination_gen->has_next();
+                if (_up_to_isomorphism)
+                    return _lookahead != nullptr;
+                return can_advance();
             }
     };
 
@@ -398,6 +721,7 @@ namespace ltsy {
 
             std::shared_ptr<NMatrix> _nmatrix_ptr;
             std::map<Prop, int> _valuation_map;
+            std::vector<int> _values_by_id; //> Same valuation, indexed by variable symbol id
             
         public:
             
@@ -413,6 +737,9 @@ namespace ltsy {
                     auto [p, v] = mapping;
                     if (v >= 0 and v < nvalues) {
                         _valuation_map.insert(mapping);
+                        if (p.symbol_id() >= _values_by_id.size())
+                            _values_by_id.resize(p.symbol_id() + 1, 0);
+                        _values_by_id[p.symbol_id()] = v;
                     } else {
                         std::cout << v;
                         throw std::invalid_argument(INVALID_TRUTH_VALUE_EXCEPTION);
@@ -432,8 +759,15 @@ namespace ltsy {
                 return _nmatrix_ptr;
             }
             
-            inline int operator()(const Prop& p) {
-                return _valuation_map[p];
+            inline int operator()(const Prop& p) const {
+                return (*this)(p.symbol_id());
+            }
+
+            /* The value of the variable with the given symbol id,
+             * 0 if not assigned.
+             * */
+            inline int operator()(SymbolId id) const {
+                return id < _values_by_id.size() ? _values_by_id[id] : 0;
             }
     };
 
@@ -462,9 +796,9 @@ namespace ltsy {
             int visit_compound(Compound* compound) override {
                 if (compound != nullptr) {
                     auto connective = compound->connective();
-                    auto conn_interp = 
+                    const auto& conn_interp = 
                         _nmatrix_valuation_ptr->nmatrix_ptr()->interpretation()
-                            ->get_interpretation(connective->symbol());
+                            ->get_interpretation(connective->symbol_id());
                     auto components = compound->components();
                     std::vector<int> args;
                     for (auto component : components) {
@@ -473,6 +807,33 @@ namespace ltsy {
                     return conn_interp->at(args);
                 } else throw std::logic_error("compound points to null");
             }
+
+            /* Evaluate every node of a formula pool in a single
+             * pass, as children come before their parents.
+             *
+             * @return the value of each node, indexed as in the pool
+             * */
+            std::vector<int> evaluate(const FormulaPool& pool) {
+                std::vector<int> values (pool.size());
+                std::vector<std::shared_ptr<TruthInterp<int>>> interps (pool.connectives().size());
+                std::vector<int> args;
+                for (std::size_t i = 0; i < pool.size(); ++i) {
+                    const auto& node = pool.node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        values[i] = (*_nmatrix_valuation_ptr)(pool.variables()[node.symbol]);
+                    } else {
+                        auto& conn_interp = interps[node.symbol];
+                        if (conn_interp == nullptr)
+                            conn_interp = _nmatrix_valuation_ptr->nmatrix_ptr()->interpretation()
+                                ->get_interpretation(pool.connectives()[node.symbol]->symbol_id());
+                        args.resize(node.arity);
+                        for (std::size_t k = 0; k < node.arity; ++k)
+                            args[k] = values[pool.child(i, k)];
+                        values[i] = conn_interp->at(args);
+                    }
+                }
+                return values;
+            }
     };
 
     /**
@@ -485,6 +846,7 @@ namespace ltsy {
             std::vector<Prop> _props;
             int _current_index = 0;
             int _total_valuations;
+            utils::RowCursor _images; //> Values of the variables in the next valuation
 
         public:
 
@@ -493,6 +855,7 @@ namespace ltsy {
                 auto number_props = _props.size();
                 auto nvalues = _nmatrix->nvalues();
                 _total_valuations = std::pow(nvalues, number_props); 
+                _images = utils::RowCursor {nvalues, static_cast<int>(number_props)};
             }
 
             bool has_next() {
@@ -502,15 +865,173 @@ namespace ltsy {
             NMatrixValuation next() {
                 if (not has_next())
                     throw std::logic_error("no valuations to generate");
-                auto images = utils::tuple_from_position(_nmatrix->nvalues(), _props.size(), _current_index);
                 std::vector<std::pair<Prop, int>> val_map;
                 for (int i = 0; i < _props.size(); ++i)
-                    val_map.push_back({_props[i], images[i]});
+                    val_map.push_back({_props[i], _images[i]});
+                _images.next();
                 ++_current_index;
                 return NMatrixValuation(std::atomic_load(&_nmatrix), val_map); 
             }
     };
 
+    /**
+     * Evaluates formulas over all the valuations of a list of
+     * variables at once, column by column: the column of a formula
+     * holds its value under each valuation, in the order of
+     * NMatrixValuationGenerator, where the i-th variable takes the
+     * i-th digit (in base nvalues) of the index of the valuation.
+     *
+     * The column of a compound is computed from those of its
+     * components by a table lookup per valuation, in plain loops
+     * over byte arrays, instead of visiting the formula once
+     * per valuation. Formulas with variables not in the list
+     * cannot be evaluated.
+     *
+     * @author Vitor Greati
+     * */
+    class NMatrixColumnarEvaluator {
+
+        public:
+            using Column = std::vector<std::uint8_t>;
+
+        private:
+            std::shared_ptr<NMatrix> _nmatrix;
+            std::vector<Prop> _props;
+            int _nvalues;
+            std::size_t _nvaluations;
+            std::vector<std::uint8_t> _designated; //> Indicates if each value is designated
+
+            Column variable_column(const Prop& p) const {
+                auto it = std::find_if(_props.begin(), _props.end(), 
+                        [&](const Prop& q) { return q.symbol_id() == p.symbol_id(); });
+                if (it == _props.end())
+                    throw std::invalid_argument("variable " + p.symbol() + " not in the columnar evaluator");
+                Column column (_nvaluations, 0);
+                // the digit of the variable changes every stride valuations
+                std::size_t stride = 1;
+                for (auto k = _props.size() - 1; k > std::size_t(it - _props.begin()); --k)
+                    stride *= _nvalues;
+                for (std::size_t v = 0; v < _nvaluations; v += stride)
+                    std::fill_n(column.begin() + v, stride, std::uint8_t((v / stride) % _nvalues));
+                return column;
+            }
+
+            Column compound_column(const TruthTable<int>& table, 
+                    const std::vector<const Column*>& components) const {
+                Column column (_nvaluations);
+                std::vector<std::uint8_t> images (table.number_of_rows());
+                for (int i = 0; i < images.size(); ++i)
+                    images[i] = table.at(i);
+                if (components.empty()) {
+                    std::fill(column.begin(), column.end(), images[0]);
+                } else if (components.size() == 1) {
+                    const auto& x = *components[0];
+                    for (std::size_t v = 0; v < _nvaluations; ++v)
+                        column[v] = images[x[v]];
+                } else {
+                    std::vector<std::uint32_t> positions (components[0]->begin(), components[0]->end());
+                    for (std::size_t k = 1; k < components.size(); ++k) {
+                        const auto& x = *components[k];
+                        for (std::size_t v = 0; v < _nvaluations; ++v)
+                            positions[v] = positions[v] * _nvalues + x[v];
+                    }
+                    for (std::size_t v = 0; v < _nvaluations; ++v)
+                        column[v] = images[positions[v]];
+                }
+                return column;
+            }
+
+        public:
+
+            NMatrixColumnarEvaluator(decltype(_nmatrix) nmatrix, const decltype(_props)& props)
+                : _nmatrix {nmatrix}, _props {props}, _nvalues {nmatrix->nvalues()} {
+                if (_nvalues > 256)
+                    throw std::invalid_argument("columnar evaluation supports up to 256 values");
+                _nvaluations = 1;
+                for (std::size_t i = 0; i < _props.size(); ++i)
+                    if (__builtin_mul_overflow(_nvaluations, std::size_t(_nvalues), &_nvaluations))
+                        throw std::overflow_error("too many valuations for columnar evaluation");
+                _designated.assign(_nvalues, 0);
+                for (auto d : _nmatrix->dvalues())
+                    _designated[d] = 1;
+            }
+
+            inline std::size_t number_of_valuations() const { return _nvaluations; }
+
+            /* The columns of every node of a formula pool,
+             * computed in a single pass over the nodes.
+             * */
+            std::vector<Column> evaluate(const FormulaPool& pool) const {
+                std::vector<Column> columns (pool.size());
+                std::vector<const Column*> components;
+                for (std::size_t i = 0; i < pool.size(); ++i) {
+                    const auto& node = pool.node(i);
+                    if (node.type == Formula::FmlaType::PROP) {
+                        columns[i] = variable_column(pool.variables()[node.symbol]);
+                    } else {
+                        const auto& interp = _nmatrix->interpretation()
+                            ->get_interpretation(pool.connectives()[node.symbol]->symbol_id());
+                        components.resize(node.arity);
+                        for (std::size_t k = 0; k < node.arity; ++k)
+                            components[k] = &columns[pool.child(i, k)];
+                        columns[i] = compound_column(*interp->truth_table(), components);
+                    }
+                }
+                return columns;
+            }
+
+            /* The column of a formula.
+             * */
+            Column evaluate(const std::shared_ptr<Formula>& fmla) const {
+                FormulaPool pool;
+                auto i = pool.add(fmla);
+                return evaluate(pool)[i];
+            }
+
+            /* The first valuation under which every premise is
+             * designated and no conclusion is, if any.
+             *
+             * @return the index of the valuation
+             * */
+            std::optional<std::size_t> counterexample(const FmlaSet& premises, const FmlaSet& conclusions) const {
+                FormulaPool pool;
+                std::vector<std::size_t> premises_nodes, conclusions_nodes;
+                for (const auto& f : premises)
+                    premises_nodes.push_back(pool.add(f));
+                for (const auto& f : conclusions)
+                    conclusions_nodes.push_back(pool.add(f));
+                auto columns = evaluate(pool);
+                Column counter_model (_nvaluations, 1);
+                for (auto i : premises_nodes)
+                    for (std::size_t v = 0; v < _nvaluations; ++v)
+                        counter_model[v] &= _designated[columns[i][v]];
+                for (auto i : conclusions_nodes)
+                    for (std::size_t v = 0; v < _nvaluations; ++v)
+                        counter_model[v] &= 1 - _designated[columns[i][v]];
+                auto it = std::find(counter_model.begin(), counter_model.end(), 1);
+                if (it == counter_model.end())
+                    return std::nullopt;
+                return it - counter_model.begin();
+            }
+
+            /* Check if a formula is designated under every valuation.
+             * */
+            bool is_valid(const std::shared_ptr<Formula>& fmla) const {
+                return not counterexample({}, {fmla});
+            }
+
+            /* The valuation at a given index.
+             * */
+            NMatrixValuation valuation(std::size_t index) const {
+                if (index >= _nvaluations)
+                    throw std::invalid_argument("invalid valuation index");
+                std::vector<std::pair<Prop, int>> mappings (_props.size(), {Prop{}, 0});
+                for (auto k = _props.size(); k-- > 0; index /= _nvalues)
+                    mappings[k] = {_props[k], int(index % _nvalues)};
+                return NMatrixValuation {_nmatrix, mappings};
+            }
+    };
+
 };
 
 #endif
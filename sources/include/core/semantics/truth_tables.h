@@ -1,23 +1,157 @@
 #ifndef __TRUTH_TABLES__
 #define __TRUTH_TABLES__
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <vector>
 #include <unordered_set>
 #include "core/utils.h"
 #include "core/common.h"
 #include "core/syntax.h"
+#include "core/exception.h"
 #include <functional>
 #include <stdexcept>
 #include <set>
 #include <memory>
 #include <map>
+#include <deque>
+#include <unordered_map>
+#include <optional>
 
 namespace ltsy {
 
     template<typename CellType> class TruthTable;
 
+    /**
+     * A set of truth-values, taken from 0..63, stored
+     * as a bitmask. Unions, intersections and inclusion
+     * tests are single word operations.
+     *
+     * Converts to and from std::set<int> without loss.
+     *
+     * @author Vitor Greati
+     * */
+    class ValueMask {
+        private:
+            std::uint64_t _bits = 0;
+
+        public:
+
+            static constexpr int MAX_VALUES = 64;
+
+            ValueMask() {/* empty */}
+
+            explicit ValueMask(std::uint64_t bits) : _bits {bits} {/* empty */}
+
+            explicit ValueMask(const std::set<int>& values) {
+                for (auto v : values)
+                    insert(v);
+            }
+
+            /* The mask of the values 0..nvalues-1.
+             * */
+            static ValueMask all(int nvalues) {
+                if (nvalues < 0 or nvalues > MAX_VALUES)
+                    throw std::invalid_argument(INVALID_TRUTH_VALUE_EXCEPTION);
+                return ValueMask {nvalues == MAX_VALUES ? ~std::uint64_t{0} 
+                    : (std::uint64_t{1} << nvalues) - 1};
+            }
+
+            static ValueMask singleton(int value) {
+                ValueMask m;
+                m.insert(value);
+                return m;
+            }
+
+            inline void insert(int value) {
+                if (value < 0 or value >= MAX_VALUES)
+                    throw std::invalid_argument(INVALID_TRUTH_VALUE_EXCEPTION);
+                _bits |= std::uint64_t{1} << value;
+            }
+
+            inline bool contains(int value) const {
+                return value >= 0 and value < MAX_VALUES and (_bits >> value) & 1;
+            }
+
+            inline std::uint64_t bits() const { return _bits; }
+            inline bool empty() const { return _bits == 0; }
+            inline int size() const { return __builtin_popcountll(_bits); }
+
+            inline bool is_subset_of(ValueMask other) const { return (_bits & ~other._bits) == 0; }
+            inline bool intersects(ValueMask other) const { return (_bits & other._bits) != 0; }
+
+            inline ValueMask operator|(ValueMask other) const { return ValueMask {_bits | other._bits}; }
+            inline ValueMask operator&(ValueMask other) const { return ValueMask {_bits & other._bits}; }
+            inline ValueMask operator-(ValueMask other) const { return ValueMask {_bits & ~other._bits}; }
+            inline ValueMask& operator|=(ValueMask other) { _bits |= other._bits; return *this; }
+            inline ValueMask& operator&=(ValueMask other) { _bits &= other._bits; return *this; }
+
+            inline bool operator==(ValueMask other) const { return _bits == other._bits; }
+            inline bool operator!=(ValueMask other) const { return _bits != other._bits; }
+            inline bool operator<(ValueMask other) const { return _bits < other._bits; }
+
+            /* Call f on each value, in increasing order.
+             * */
+            template<typename F>
+            void for_each(F f) const {
+                for (auto bits = _bits; bits != 0; bits &= bits - 1)
+                    f(__builtin_ctzll(bits));
+            }
+
+            std::set<int> to_set() const {
+                std::set<int> values;
+                for_each([&](int v) { values.insert(values.end(), v); });
+                return values;
+            }
+
+            friend std::ostream& operator<<(std::ostream& os, const ValueMask& mask) {
+                os << "{";
+                bool first = true;
+                mask.for_each([&](int v) { os << (first ? "" : ",") << v; first = false; });
+                os << "}";
+                return os;
+            }
+    };
+
+    /* Hash of the contents of a cell.
+     * */
+    inline std::size_t hash_cell(int value) {
+        return std::hash<int>{}(value);
+    }
+
+    inline std::size_t hash_cell(const std::set<int>& values) {
+        std::size_t seed = values.size();
+        for (auto v : values)
+            utils::hash_combine(seed, v);
+        return seed;
+    }
+
+    inline std::size_t hash_cell(ValueMask values) {
+        return std::hash<std::uint64_t>{}(values.bits());
+    }
+
+    /* Rename the values in a cell, each v by sigma[v].
+     * */
+    inline int permute_values(int value, const std::vector<int>& sigma) {
+        return sigma[value];
+    }
+
+    inline std::set<int> permute_values(const std::set<int>& values, const std::vector<int>& sigma) {
+        std::set<int> result;
+        for (auto v : values)
+            result.insert(sigma[v]);
+        return result;
+    }
+
+    inline ValueMask permute_values(ValueMask values, const std::vector<int>& sigma) {
+        ValueMask result;
+        values.for_each([&](int v) { result.insert(sigma[v]); });
+        return result;
+    }
+
     /**
      * Represents a determinant. 
      *
@@ -61,7 +195,7 @@ namespace ltsy {
             inline void set_last(CellType& value) { _data.second = value; }
 
             inline std::vector<int> get_args() const { 
-                return utils::tuple_from_position(_nvalues, _arity, _data.first); 
+                return utils::RowCursor {_nvalues, _arity, _data.first}.tuple(); 
             }
 
             inline bool has_only_args(const std::set<int>& vs) const {
@@ -103,6 +237,95 @@ namespace ltsy {
             }
     };
 
+    template<typename CellType> class TruthTableBase;
+
+    /**
+     * A determinant read in place from a truth table: the
+     * arguments come from the cursor of a determinant range,
+     * and the image and value names from the table.
+     *
+     * It is valid while the range iterator that produced it
+     * is not advanced. Use to_determinant for an owning copy.
+     *
+     * @author Vitor Greati
+     * */
+    template<typename CellType>
+    class DeterminantView {
+        private:
+            const TruthTableBase<CellType>* _table;
+            const utils::RowCursor* _row;
+
+        public:
+
+            DeterminantView(const TruthTableBase<CellType>* table, const utils::RowCursor* row)
+                : _table {table}, _row {row} {/* empty */}
+
+            inline const std::vector<int>& get_args() const { return _row->tuple(); }
+
+            inline int get_args_pos() const { return _row->position(); }
+
+            inline const CellType& get_last() const { return _table->image_at(_row->position()); }
+
+            inline bool has_only_args(const std::set<int>& vs) const {
+                for (auto arg : get_args())
+                    if (vs.find(arg) == vs.end())
+                        return false;
+                return true;
+            }
+
+            inline std::string get_value_name(int value) const { return _table->get_value_name(value); }
+
+            Determinant<CellType> to_determinant() const {
+                return Determinant<CellType> {_table->nvalues(), _table->arity(), get_args_pos(), 
+                    get_last(), _table->get_values_names()};
+            }
+    };
+
+    /**
+     * Lazy range over the determinants of a truth table,
+     * in the order of the rows. It does not own the table.
+     *
+     * @author Vitor Greati
+     * */
+    template<typename CellType>
+    class DeterminantRange {
+        private:
+            const TruthTableBase<CellType>* _table;
+
+        public:
+
+            class iterator {
+                private:
+                    const TruthTableBase<CellType>* _table;
+                    utils::RowCursor _row;
+
+                public:
+                    using iterator_category = std::input_iterator_tag;
+                    using value_type = DeterminantView<CellType>;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = void;
+                    using reference = DeterminantView<CellType>;
+
+                    iterator(const TruthTableBase<CellType>* table, int position)
+                        : _table {table}, _row {table->nvalues(), table->arity(), position} {/* empty */}
+
+                    inline DeterminantView<CellType> operator*() const { return {_table, &_row}; }
+
+                    inline iterator& operator++() { _row.next(); return *this; }
+
+                    inline bool operator==(const iterator& other) const { 
+                        return _row.position() == other._row.position(); 
+                    }
+                    inline bool operator!=(const iterator& other) const { return not (*this == other); }
+            };
+
+            explicit DeterminantRange(const TruthTableBase<CellType>* table) : _table {table} {/* empty */}
+
+            inline iterator begin() const { return iterator {_table, 0}; }
+            inline iterator end() const { return iterator {_table, _table->number_of_rows()}; }
+            inline int size() const { return _table->number_of_rows(); }
+    };
+
     /**
      * Represents an `NValues`-valued `Arity`-ary truth table. 
      * Values are taken to be 0,...,`NValues`-1.
@@ -128,8 +351,38 @@ namespace ltsy {
 
             std::map<int, std::string> _values_names;
 
+            //> Hash of the images, computed on demand and kept up to date by set
+            mutable std::size_t _hash = 0;
+            mutable bool _hashed = false;
+
+            /* Counter of the modifications of the images of a table,
+             * which also changes when the table is assigned, so that
+             * a table keeps its version only while its images stay.
+             * */
+            struct Version {
+                std::uint64_t value = 0;
+                Version() = default;
+                Version(const Version& other) : value {other.value} {}
+                Version& operator=(const Version& other) {
+                    value = std::max(value, other.value) + 1;
+                    return *this;
+                }
+            };
+            Version _version;
+
             using TruthTableRow = std::pair<std::vector<int>, CellType>;
 
+            /* The contribution of a row to the hash, which is the
+             * sum of those of all rows, so that changing a
+             * row updates it in constant time.
+             * */
+            static std::size_t row_hash(int i, const CellType& image) {
+                std::uint64_t h = hash_cell(image) ^ (std::uint64_t(i) * 0x9e3779b97f4a7c15ULL);
+                h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+                return h ^ (h >> 31);
+            }
+
             static constexpr auto compute_number_of_rows = [](int nvalues, int arity) { return int(std::pow(nvalues, arity)); };
 
         public:
@@ -178,14 +431,61 @@ namespace ltsy {
             }
 
             bool operator==(const TruthTableBase<CellType>& other) const {
+                if (_hashed and other._hashed and _hash != other._hash)
+                    return false;
                 return this->_images == other._images;
             }
 
+            bool operator!=(const TruthTableBase<CellType>& other) const {
+                return not (*this == other);
+            }
+
+            /* Hash of the images, cached.
+             * */
+            std::size_t hash() const {
+                if (not _hashed) {
+                    _hash = 0;
+                    for (int i = 0; i < _images.size(); ++i)
+                        _hash += row_hash(i, _images[i]);
+                    _hashed = true;
+                }
+                return _hash;
+            }
+
             /* Gives the image at the given position.
              * */
             inline CellType at(int i) const { return _images[i]; }
 
-            inline void set(int i, const CellType& v) { _images[i] = v; }
+            /* Gives a reference to the image at the given position.
+             * */
+            inline const CellType& image_at(int i) const { return _images[i]; }
+
+            inline void set(int i, const CellType& v) {
+                if (_hashed)
+                    _hash += row_hash(i, v) - row_hash(i, _images[i]);
+                _images[i] = v; 
+                ++_version.value;
+            }
+
+            /* Identifies the current images of this table, for
+             * invalidating data computed from them.
+             * */
+            inline std::uint64_t version() const { return _version.value; }
+
+            /* The images of the table isomorphic to this one by
+             * the renaming of each value v by sigma[v], that is,
+             * t'(sigma(x1),...,sigma(xk)) = sigma(t(x1,...,xk)).
+             * */
+            decltype(_images) permuted_images(const std::vector<int>& sigma) const {
+                decltype(_images) result (_images.size());
+                for (utils::RowCursor row {_nvalues, _arity}; not row.done(); row.next()) {
+                    int position = 0;
+                    for (int k = 0; k < _arity; ++k)
+                        position = position * _nvalues + sigma[row[k]];
+                    result[position] = permute_values(_images[row.position()], sigma);
+                }
+                return result;
+            }
 
             /* Return the image at a given input tuple.
              * */
@@ -195,6 +495,27 @@ namespace ltsy {
 
             inline int nvalues() const { return _nvalues; }
 
+            /* Check if the arguments of a row are all in a set of values.
+             * */
+            bool has_only_args(int row, ValueMask values) const {
+                for (int k = 0; k < _arity; ++k, row /= _nvalues)
+                    if (not values.contains(row % _nvalues))
+                        return false;
+                return true;
+            }
+
+            /* Call f on every row whose k-th argument is in args[k].
+             * */
+            template<typename F>
+            void for_each_row_in(const std::vector<ValueMask>& args, const F& f, 
+                    int k = 0, int row = 0) const {
+                if (k == _arity) {
+                    f(row);
+                    return;
+                }
+                args[k].for_each([&](int v) { for_each_row_in(args, f, k + 1, row * _nvalues + v); });
+            }
+
             void update(const std::set<Determinant<CellType>>& dets) {
                 for (auto e : dets)
                     set(e.get_args_pos(), e.get_last()); 
@@ -208,6 +529,12 @@ namespace ltsy {
                 } 
             }
 
+            /* Lazy view of the determinants, in the order of the rows.
+             * */
+            inline DeterminantRange<CellType> determinants() const {
+                return DeterminantRange<CellType> {this};
+            }
+
             std::set<Determinant<CellType>> get_determinants() const {
                 std::set<Determinant<CellType>> result;
                 for (auto i {0}; i < _images.size(); ++i){
@@ -218,8 +545,9 @@ namespace ltsy {
             }
 
             friend std::ostream& operator<<(std::ostream& os, const TruthTableBase<CellType>& tt) {
-                for (auto i = 0; i < tt._images.size(); ++i) {
-                    auto row = utils::tuple_from_position(tt._nvalues, tt._arity, i);
+                utils::RowCursor cursor {tt._nvalues, tt._arity};
+                for (auto i = 0; i < tt._images.size(); ++i, cursor.next()) {
+                    const auto& row = cursor.tuple();
                     for (auto it = row.cbegin(); it != row.cend(); it++) {
                         os << (*it);
                         if (std::next(it) != row.cend())
@@ -251,6 +579,7 @@ namespace ltsy {
     };
 
     template class TruthTableBase<std::set<int>>;
+    template class TruthTableBase<ValueMask>;
     template class TruthTableBase<int>;
 
     template<typename CellType = int>
@@ -273,11 +602,9 @@ namespace ltsy {
              * */
             std::set<std::set<int>> partial_inputs() const {
                 std::set<std::set<int>> result;
-                for (const auto& det : get_determinants()) {
-                    if (det.get_last().empty()) {
-                        auto args = det.get_args();
-                        result.insert(std::set<int>{args.begin(), args.end()}); 
-                    }
+                for (utils::RowCursor row {_nvalues, _arity}; not row.done(); row.next()) {
+                    if (_images[row.position()].empty())
+                        result.insert(std::set<int>{row.tuple().begin(), row.tuple().end()}); 
                 } 
                 return result;
             }   
@@ -288,16 +615,11 @@ namespace ltsy {
              * */
             bool
             is_sub_table_total(const std::set<int>& subvalues) const {
-                auto dets = this->get_determinants();
-                for (const auto det : dets) {
-                    if (not det.has_only_args(subvalues))
+                ValueMask submask {subvalues};
+                for (auto i {0}; i < _images.size(); ++i) {
+                    if (not has_only_args(i, submask))
                         continue;
-                    auto adjusted_det = det;
-                    std::set<int> inters;
-                    auto det_last = det.get_last();
-                    std::set_intersection(det_last.begin(), det_last.end(),
-                            subvalues.begin(), subvalues.end(), std::inserter(inters, inters.begin()));
-                    if (inters.empty())
+                    if (not ValueMask{_images[i]}.intersects(submask))
                         return false;
                 }
                 return true;
@@ -313,115 +635,538 @@ namespace ltsy {
             get_sub_table_determinants(const std::set<int>& subvalues) const {
                 std::set<Determinant<std::set<int>>> result;
                 std::set<Determinant<std::set<int>>> empty_dets;
-                auto dets = this->get_determinants();
-                for (const auto det : dets) {
-                    if (not det.has_only_args(subvalues))
+                ValueMask submask {subvalues};
+                for (auto i {0}; i < _images.size(); ++i) {
+                    if (not has_only_args(i, submask))
                         continue;
-                    auto adjusted_det = det;
-                    std::set<int> inters;
-                    auto det_last = det.get_last();
-                    std::set_intersection(det_last.begin(), det_last.end(),
-                            inters.begin(), inters.end(), std::inserter(inters, inters.begin()));
-                    adjusted_det.set_last(inters);
+                    Determinant<std::set<int>> adjusted_det {_nvalues, _arity, i, 
+                        (ValueMask{_images[i]} & submask).to_set(), _values_names};
                     result.insert(adjusted_det);
-                    if (inters.empty())
+                    if (adjusted_det.get_last().empty())
                         empty_dets.insert(adjusted_det);
                 }
                 return {result, empty_dets};
             }
 
-            TruthTable<std::set<int>> compose(const std::vector<TruthTable<std::set<int>>>& gs) const {
-                if (gs.size() != this->_arity)
-                    throw std::invalid_argument("wrong parameters number on composition of truth-table");
+            /* The union of the images of every input
+             * whose i-th argument is in args[i].
+             * */
+            ValueMask image(const std::vector<ValueMask>& args) const;
 
-                if (this->_arity == 0)
-                    return *this;
+            TruthTable<std::set<int>> compose(const std::vector<TruthTable<std::set<int>>>& gs) const;
+    };
 
-                auto arity = gs[0].arity();
+    /**
+     * Non-deterministic truth table whose cells are
+     * bitmasks of values.
+     *
+     * @author Vitor Greati
+     * */
+    template<>
+    class TruthTable<ValueMask> : public TruthTableBase<ValueMask> {
 
-                for (auto g : gs)
-                    if (g.arity() != arity)
-                        throw std::invalid_argument("the components must have the same arity");
+        public:
+            using TruthTableBase<ValueMask>::TruthTableBase;
 
-                auto number_of_rows = gs[0].number_of_rows();
+            TruthTable() {/* empty */}
 
-                auto validate_input = [&](const std::vector<int>& input, int l) -> bool {
-                    for (int i = 0; i < input.size(); ++i) {
-                        for (int j = i+1; j < input.size(); ++j) {
-                            if (gs[i].at(l) == gs[j].at(l)
-                                   and input[i] != input[j]) return false; 
-                        }
+            /* Convert a table of sets of values.
+             * */
+            explicit TruthTable(const TruthTable<std::set<int>>& table)
+                : TruthTableBase<ValueMask> {table.nvalues(), table.arity(), table.fmla()} {
+                for (auto i {0}; i < _images.size(); ++i)
+                    _images[i] = ValueMask {table.at(i)};
+                _name = table.name();
+                _values_names = table.get_values_names();
+            }
+
+            /* Convert back to a table of sets of values.
+             * */
+            TruthTable<std::set<int>> to_set_table() const {
+                TruthTable<std::set<int>> table {_nvalues, _arity, _fmla};
+                for (auto i {0}; i < _images.size(); ++i)
+                    table.set(i, _images[i].to_set());
+                table.set_name(_name);
+                table.set_values_names(_values_names);
+                return table;
+            }
+
+            /* Return a set of all sets X = {x1,...,xn} s.t. *(x1,...,xn) = empty.
+             * */
+            std::set<std::set<int>> partial_inputs() const {
+                std::set<std::set<int>> result;
+                for (utils::RowCursor row {_nvalues, _arity}; not row.done(); row.next()) {
+                    if (_images[row.position()].empty())
+                        result.insert(std::set<int>{row.tuple().begin(), row.tuple().end()}); 
+                } 
+                return result;
+            }   
+
+            /* Check if the sub table given by some of
+             * the values is total.
+             * */
+            bool is_sub_table_total(ValueMask subvalues) const {
+                for (auto i {0}; i < _images.size(); ++i)
+                    if (has_only_args(i, subvalues) and not _images[i].intersects(subvalues))
+                        return false;
+                return true;
+            }
+
+            /* Return the determinants of the sub table given by
+             * some of the values, and those among them having empty outputs.
+             * */
+            std::pair<std::set<Determinant<ValueMask>>, std::set<Determinant<ValueMask>>>
+            get_sub_table_determinants(ValueMask subvalues) const {
+                std::set<Determinant<ValueMask>> result;
+                std::set<Determinant<ValueMask>> empty_dets;
+                for (auto i {0}; i < _images.size(); ++i) {
+                    if (not has_only_args(i, subvalues))
+                        continue;
+                    Determinant<ValueMask> adjusted_det {_nvalues, _arity, i, 
+                        _images[i] & subvalues, _values_names};
+                    result.insert(adjusted_det);
+                    if (adjusted_det.get_last().empty())
+                        empty_dets.insert(adjusted_det);
+                }
+                return {result, empty_dets};
+            }
+
+            /* The union of the images of every input
+             * whose i-th argument is in args[i].
+             * */
+            ValueMask image(const std::vector<ValueMask>& args) const {
+                if (args.size() != _arity)
+                    throw std::invalid_argument(ltsy::WRONG_ARITY_INPUT_EXCEPTION);
+                ValueMask result;
+                for_each_row_in(args, [&](int row) { result |= _images[row]; });
+                return result;
+            }
+
+            TruthTable<ValueMask> compose(const std::vector<TruthTable<ValueMask>>& gs) const;
+    };
+
+    using NDMaskTruthTable = TruthTable<ValueMask>;
+
+    /* Composition kernel for tables of bitmask cells.
+     *
+     * The image of f(g1,...,gk) at a row is the union of the
+     * images of f at every tuple (x1,...,xk) with each xi in gi(row),
+     * where components having the same image at the row are
+     * given the same value. The tuples are enumerated by an
+     * odometer over the bits of the components, kept in scratch
+     * buffers reused among calls, and the enumeration stops as soon
+     * as the image has every value. Rows where every component is
+     * deterministic are looked up directly.
+     *
+     * @author Vitor Greati
+     * */
+    class NDMaskTableComposer {
+
+        private:
+            std::vector<ValueMask> _args;
+            std::vector<int> _tied_to;
+            std::vector<std::uint64_t> _remaining;
+            std::vector<int> _chosen;
+            std::vector<int> _weights;
+
+            void prepare(const NDMaskTruthTable& f) {
+                auto arity = f.arity();
+                _args.resize(arity);
+                _tied_to.resize(arity);
+                _remaining.resize(arity);
+                _chosen.resize(arity);
+                _weights.resize(arity);
+                for (int j = arity - 1, w = 1; j >= 0; --j, w *= f.nvalues())
+                    _weights[j] = w;
+            }
+
+            /* The image of f at the inputs given by _args,
+             * respecting _tied_to.
+             * */
+            ValueMask compose_row(const NDMaskTruthTable& f, ValueMask all) {
+                int arity = _args.size();
+                bool deterministic = true;
+                for (int j = 0; j < arity; ++j) {
+                    auto size = _args[j].size();
+                    if (size == 0)
+                        return ValueMask {};
+                    deterministic = deterministic and size == 1;
+                }
+                int position = 0;
+                if (deterministic) {
+                    for (int j = 0; j < arity; ++j)
+                        position += _weights[j] * __builtin_ctzll(_args[j].bits());
+                    return f.image_at(position);
+                }
+                for (int j = 0; j < arity; ++j)
+                    _remaining[j] = _args[j].bits();
+                ValueMask result;
+                while (true) {
+                    position = 0;
+                    for (int j = 0; j < arity; ++j) {
+                        _chosen[j] = _tied_to[j] < 0 ? __builtin_ctzll(_remaining[j]) : _chosen[_tied_to[j]];
+                        position += _weights[j] * _chosen[j];
                     }
-                    return true;
-                };
+                    result |= f.image_at(position);
+                    if (result == all)
+                        return result;
+                    // advance the odometer over the untied components
+                    int j = arity - 1;
+                    for (; j >= 0; --j) {
+                        if (_tied_to[j] >= 0)
+                            continue;
+                        _remaining[j] &= _remaining[j] - 1;
+                        if (_remaining[j] != 0)
+                            break;
+                        _remaining[j] = _args[j].bits();
+                    }
+                    if (j < 0)
+                        return result;
+                }
+            }
+
+        public:
 
+            /* Compose f with the tables in gs, writing into result.
+             *
+             * @param f the outer table
+             * @param gs the components, all with the same arity
+             * @param result the table receiving the composition
+             * */
+            void compose(const NDMaskTruthTable& f, const std::vector<const NDMaskTruthTable*>& gs,
+                    NDMaskTruthTable& result) {
+                if (gs.size() != f.arity())
+                    throw std::invalid_argument("wrong parameters number on composition of truth-table");
+                if (f.arity() == 0) {
+                    result = f;
+                    return;
+                }
+                auto arity = gs[0]->arity();
+                for (const auto g : gs)
+                    if (g->arity() != arity)
+                        throw std::invalid_argument("the components must have the same arity");
                 // composing fmlas
                 std::shared_ptr<Formula> result_fmla = nullptr;
-                if (this->_fmla != nullptr) {
+                if (f.fmla() != nullptr) {
                     std::vector<std::shared_ptr<Formula>> component_fmlas;
-                    for (const auto& g : gs) {
-                        if (g.fmla() != nullptr) 
-                            component_fmlas.push_back(g.fmla());
-                    }
-                    if (component_fmlas.size() == gs.size()) {
-                        result_fmla = std::make_shared<Compound>(this->_fmla->connective(), component_fmlas);
+                    for (const auto g : gs) {
+                        if (g->fmla() != nullptr) 
+                            component_fmlas.push_back(g->fmla());
                     }
+                    if (component_fmlas.size() == gs.size())
+                        result_fmla = std::make_shared<Compound>(f.fmla()->connective(), component_fmlas);
                 }
-
-                TruthTable<std::set<int>> result {_nvalues, arity, result_fmla};
+                result = NDMaskTruthTable {f.nvalues(), arity, result_fmla};
+                prepare(f);
+                auto all = ValueMask::all(f.nvalues());
+                auto number_of_rows = gs[0]->number_of_rows();
                 for (int i = 0; i < number_of_rows; ++i) {
-                    // collect images of g's
-                    std::vector<std::set<int>> gsimages;
-                    for (const auto& g : gs)
-                        gsimages.push_back(g.at(i));
-                    const auto& cartproduct = utils::cartesian_product(gsimages);
-                    std::set<int> comp_output;
-                    for (const auto& input : cartproduct) {
-                        if (not validate_input(input, i)) continue;
-                        const auto& foutput = this->at(input);
-                        comp_output.insert(foutput.begin(), foutput.end()); 
+                    for (int j = 0; j < gs.size(); ++j) {
+                        _args[j] = gs[j]->image_at(i);
+                        // components with the same image at the row
+                        // are given the same value
+                        _tied_to[j] = -1;
+                        for (int k = 0; k < j and _tied_to[j] < 0; ++k)
+                            if (_args[k] == _args[j] and _args[j].size() > 1)
+                                _tied_to[j] = k;
                     }
-                    result.set(i, comp_output);
+                    result.set(i, compose_row(f, all));
                 }
-                return result;
-            } 
+            }
 
+            NDMaskTruthTable compose(const NDMaskTruthTable& f, const std::vector<NDMaskTruthTable>& gs) {
+                std::vector<const NDMaskTruthTable*> components;
+                components.reserve(gs.size());
+                for (const auto& g : gs)
+                    components.push_back(&g);
+                NDMaskTruthTable result;
+                compose(f, components, result);
+                return result;
+            }
     };
 
+    inline NDMaskTruthTable TruthTable<ValueMask>::compose(const std::vector<NDMaskTruthTable>& gs) const {
+        return NDMaskTableComposer {}.compose(*this, gs);
+    }
+
+    inline ValueMask TruthTable<std::set<int>>::image(const std::vector<ValueMask>& args) const {
+        if (args.size() != _arity)
+            throw std::invalid_argument(ltsy::WRONG_ARITY_INPUT_EXCEPTION);
+        ValueMask result;
+        for_each_row_in(args, [&](int row) {
+            for (auto v : _images[row])
+                result.insert(v);
+        });
+        return result;
+    }
+
+    inline TruthTable<std::set<int>> TruthTable<std::set<int>>::compose(
+            const std::vector<TruthTable<std::set<int>>>& gs) const {
+        std::vector<TruthTable<ValueMask>> masked_gs;
+        masked_gs.reserve(gs.size());
+        for (const auto& g : gs)
+            masked_gs.emplace_back(g);
+        return TruthTable<ValueMask> {*this}.compose(masked_gs).to_set_table();
+    }
+
     using NDTruthTable = TruthTable<std::set<int>>;
 
     NDTruthTable generate_fully_nd_table(int nvalues, int arity);
     NDTruthTable generate_fully_partial_table(int nvalues, int arity);
         
+    /* The canonical form of a truth table w.r.t. a group
+     * of permutations of the values: its isomorphic copy with
+     * the least images.
+     *
+     * @param table the table
+     * @param permutations the permutations in the group other
+     *        than the identity
+     * @return the canonical form
+     * */
+    template<typename CellType>
+    TruthTable<CellType> canonical_form(const TruthTable<CellType>& table,
+            const std::vector<std::vector<int>>& permutations) {
+        std::vector<CellType> least;
+        for (int i = 0; i < table.number_of_rows(); ++i)
+            least.push_back(table.at(i));
+        for (const auto& sigma : permutations) {
+            auto images = table.permuted_images(sigma);
+            if (images < least)
+                least = images;
+        }
+        TruthTable<CellType> result = table;
+        for (int i = 0; i < least.size(); ++i)
+            result.set(i, least[i]);
+        return result;
+    }
+
+    /**
+     * A set of truth tables, kept in insertion order and
+     * indexed by their hashes for constant-time membership.
+     *
+     * The references to the stored tables remain valid
+     * as new tables are inserted. The sum of the hashes
+     * of the tables is kept, so that stores with different 
+     * contents are usually told apart without comparing them.
+     *
+     * @author Vitor Greati
+     * */
+    template<typename CellType>
+    class TruthTableStore {
+
+        private:
+            std::deque<TruthTable<CellType>> _tables;
+            std::unordered_multimap<std::size_t, std::size_t> _index; //> hash to position in _tables
+            std::size_t _content_hash = 0;
+
+        public:
+
+            TruthTableStore() {/* empty */}
+
+            template<typename Container>
+            explicit TruthTableStore(const Container& tables) {
+                for (const auto& t : tables)
+                    insert(t);
+            }
+
+            /* Find the position of a table.
+             *
+             * @return the position, or -1 if it is absent
+             * */
+            int find(const TruthTable<CellType>& table) const {
+                auto [begin, end] = _index.equal_range(table.hash());
+                for (auto it = begin; it != end; ++it)
+                    if (_tables[it->second] == table)
+                        return it->second;
+                return -1;
+            }
+
+            inline bool contains(const TruthTable<CellType>& table) const { return find(table) >= 0; }
+
+            /* Insert a table, if it is absent.
+             *
+             * @return true if the table was inserted
+             * */
+            bool insert(const TruthTable<CellType>& table) {
+                if (contains(table))
+                    return false;
+                _index.emplace(table.hash(), _tables.size());
+                _tables.push_back(table);
+                _content_hash += table.hash();
+                return true;
+            }
+
+            inline std::size_t size() const { return _tables.size(); }
+
+            /* The table at a position in the insertion order.
+             * */
+            inline const TruthTable<CellType>& operator[](std::size_t i) const { return _tables[i]; }
+
+            inline auto begin() const { return _tables.cbegin(); }
+            inline auto end() const { return _tables.cend(); }
+
+            inline std::size_t content_hash() const { return _content_hash; }
+
+            bool operator==(const TruthTableStore<CellType>& other) const {
+                if (size() != other.size() or _content_hash != other._content_hash)
+                    return false;
+                for (const auto& t : _tables)
+                    if (not other.contains(t))
+                        return false;
+                return true;
+            }
+
+            bool operator!=(const TruthTableStore<CellType>& other) const {
+                return not (*this == other);
+            }
+    };
+
+    /* Generator of all the deterministic truth tables
+     * of a given arity, in lexicographical order of their
+     * images. The i-th table is the one whose images, read as
+     * digits in base nvalues, give i, so that any table can be
+     * reached by its index and any contiguous range of indices
+     * can be enumerated on its own, e.g. by different threads,
+     * or resumed from a given index.
+     *
+     * @author Vitor Greati
+     * */
     class TruthTableGenerator {
+
+        public:
+            using Index = std::uint64_t;
         
         private:
-            int _current_index = 0;
+            Index _current_index = 0;
+            Index _begin = 0;
+            Index _end = 0;
             int _nvalues;
             int _arity;
-            int _quantity;
+            Index _quantity = 0;
             int _number_of_rows;
+            std::vector<int> _images; //> Images of the next table to generate
             std::shared_ptr<TruthTable<int>> _current;
 
+            /* Advance the images to those of the next index.
+             * */
+            void advance() {
+                for (int i = _number_of_rows - 1; i >= 0; --i) {
+                    if (++_images[i] < _nvalues)
+                        return;
+                    _images[i] = 0;
+                }
+            }
+
+            /* The images of the table at the given index.
+             * */
+            std::vector<int> images_at(Index index) const {
+                std::vector<int> images (_number_of_rows);
+                for (int i = _number_of_rows - 1; i >= 0; --i) {
+                    images[i] = index % _nvalues;
+                    index /= _nvalues;
+                }
+                return images;
+            }
+
         public:
 
             TruthTableGenerator() {}
 
-            TruthTableGenerator(int nvalues, int arity) 
+            /* Generator of the tables with indices in [begin, end).
+             *
+             * @param nvalues the number of truth-values
+             * @param arity the arity of the tables
+             * @param begin the index of the first table
+             * @param end one past the index of the last table, 
+             *        defaulting to the number of tables
+             * */
+            TruthTableGenerator(int nvalues, int arity, 
+                    Index begin = 0, std::optional<Index> end = std::nullopt) 
                 : _nvalues {nvalues}, _arity {arity} {
                 _number_of_rows = utils::compute_number_of_rows(nvalues, arity);
-                _quantity = _arity > 0 ? utils::compute_number_of_functions(nvalues, arity) : _nvalues;
+                _quantity = utils::compute_number_of_functions(nvalues, arity);
+                _begin = begin;
+                _end = end.value_or(_quantity);
+                if (_begin > _end or _end > _quantity)
+                    throw std::invalid_argument(WRONG_TABLE_INDEX_EXCEPTION);
                 reset();
             }
 
+            /* The number of tables of the given arity,
+             * regardless of the range.
+             * */
+            inline Index quantity() const { return _quantity; }
+
+            inline Index begin_index() const { return _begin; }
+            inline Index end_index() const { return _end; }
+
+            /* The index of the next table to generate.
+             * */
+            inline Index current_index() const { return _current_index; }
+
+            /* The generator of a sub-range of this one.
+             * */
+            TruthTableGenerator slice(Index begin, Index end) const {
+                if (begin < _begin or end > _end)
+                    throw std::invalid_argument(WRONG_TABLE_INDEX_EXCEPTION);
+                return TruthTableGenerator {_nvalues, _arity, begin, end};
+            }
+
+            /* Split the range into (at most) parts contiguous
+             * slices of nearly equal sizes.
+             * */
+            std::vector<TruthTableGenerator> split(Index parts) const {
+                if (parts == 0)
+                    throw std::invalid_argument("the number of parts must be positive");
+                std::vector<TruthTableGenerator> slices;
+                auto size = _end - _begin;
+                auto begin = _begin;
+                for (Index k = 0; k < parts and begin < _end; ++k) {
+                    auto end = begin + size / parts + (k < size % parts ? 1 : 0);
+                    slices.push_back(slice(begin, end));
+                    begin = end;
+                }
+                return slices;
+            }
+
+            /* The table at the given index.
+             * */
+            TruthTable<int> unrank(Index index) const {
+                if (index >= _quantity)
+                    throw std::invalid_argument(WRONG_TABLE_INDEX_EXCEPTION);
+                return TruthTable<int> {_nvalues, _arity, images_at(index)};
+            }
+
+            /* The index of a given table.
+             * */
+            Index rank(const TruthTable<int>& table) const {
+                if (table.nvalues() != _nvalues or table.arity() != _arity)
+                    throw std::invalid_argument(WRONG_TABLE_INDEX_EXCEPTION);
+                Index index = 0;
+                for (int i = 0; i < _number_of_rows; ++i)
+                    index = index * _nvalues + table.at(i);
+                return index;
+            }
+
+            /* Move to the given index in the range,
+             * so that it is the next one to generate.
+             * */
+            void seek(Index index) {
+                if (index < _begin or index > _end)
+                    throw std::invalid_argument(WRONG_TABLE_INDEX_EXCEPTION);
+                _current_index = index;
+                _images = images_at(index < _quantity ? index : 0);
+                _current = std::make_shared<TruthTable<int>>(_nvalues, _arity, _images);
+            }
+
             decltype(_current) current() {
                 return _current;
             }
 
             decltype(_current) next() {
                 if (has_next()) {
-                    auto images = utils::tuple_from_position(_nvalues, _number_of_rows, _current_index);
-                    _current = std::make_shared<TruthTable<int>>(_nvalues, _arity, images);
+                    _current = std::make_shared<TruthTable<int>>(_nvalues, _arity, _images);
+                    advance();
                     ++_current_index;
                     return _current;
                 } else {
@@ -430,16 +1175,32 @@ namespace ltsy {
             }
 
             void reset() {
-                _current_index = 0;
-                auto images = utils::tuple_from_position(_nvalues, _number_of_rows, _current_index);
-                _current = std::make_shared<TruthTable<int>>(_nvalues, _arity, images);
+                seek(_begin);
             }
 
             bool has_next() {
-                return _current_index < _quantity;
+                return _current_index < _end;
             }
 
     };
 };
 
+namespace std {
+
+    template<typename CellType>
+    struct hash<ltsy::TruthTableBase<CellType>> {
+        std::size_t operator()(const ltsy::TruthTableBase<CellType>& table) const {
+            return table.hash();
+        }
+    };
+
+    template<typename CellType>
+    struct hash<ltsy::TruthTable<CellType>> {
+        std::size_t operator()(const ltsy::TruthTable<CellType>& table) const {
+            return table.hash();
+        }
+    };
+
+};
+
 #endif
@@ -0,0 +1,164 @@
+#ifndef __BINARY_SERIALIZATION__
+#define __BINARY_SERIALIZATION__
+
+#include <cstdint>
+#include <string>
+#include "core/syntax.h"
+#include "core/exception/exceptions.h"
+#include "core/semantics/truth_tables.h"
+#include "core/semantics/genmatrix.h"
+#include "core/proof-theory/multconc.h"
+
+namespace ltsy::binary {
+
+    /* Layout (integers are little-endian, strings are
+     * prefixed by their 32-bit length):
+     *
+     * - header: magic "LTSY", 16-bit version, 16-bit kind
+     * - formulas: the variable table, the connective table
+     *   (symbol and arity) and the nodes in post-order, each
+     *   with its type, symbol index and child node indices,
+     *   so that shared subformulas are stored once
+     * - body: the artifact, referring to formulas by node index
+     *
+     * Truth table cells are 64-bit masks of values.
+     * */
+    const std::uint32_t MAGIC = 0x5953544C; //> "LTSY" as little-endian bytes
+    const std::uint16_t VERSION = 1;
+    const std::uint32_t NO_FORMULA = 0xFFFFFFFF;
+
+    enum class Kind : std::uint16_t {
+        FMLA_SET = 1,
+        TRUTH_TABLE = 2,
+        GEN_MATRIX = 3,
+        CALCULUS = 4
+    };
+
+    /**
+     * Writes truth tables, matrices, calculi and
+     * sets of formulas in the binary format.
+     *
+     * @author Vitor Greati
+     * */
+    class BinaryWriter {
+
+        private:
+            FormulaPool _pool;
+            std::string _body;
+
+            void put_u8(std::string& out, std::uint8_t v) const { out.push_back(static_cast<char>(v)); }
+            void put_u16(std::string& out, std::uint16_t v) const;
+            void put_u32(std::string& out, std::uint32_t v) const;
+            void put_u64(std::string& out, std::uint64_t v) const;
+            void put_string(std::string& out, const std::string& s) const;
+
+            void put_fmla(const std::shared_ptr<Formula>& fmla);
+            void put_fmla_set(const FmlaSet& fmlas);
+            void put_values_names(const std::map<int, std::string>& names);
+            void put_truth_table(const NDTruthTable& table);
+
+            /* Header and formula section, followed by the body.
+             * */
+            std::string finish(Kind kind);
+
+        public:
+
+            std::string write(const FmlaSet& fmlas);
+            std::string write(const NDTruthTable& table);
+            std::string write(const GenMatrix& matrix);
+            std::string write(const MultipleConclusionCalculus& calculus);
+
+            /* Write the bytes produced by write into a file.
+             * */
+            static void write_file(const std::string& path, const std::string& bytes);
+    };
+
+    /**
+     * Reads artifacts in the binary format directly from a range
+     * of bytes, e.g. a memory-mapped file, without copying it.
+     *
+     * The formulas are built by a factory, which restores
+     * the sharing of subformulas.
+     *
+     * @author Vitor Greati
+     * */
+    class BinaryReader {
+
+        private:
+            const unsigned char* _data;
+            std::size_t _size;
+            std::size_t _offset = 0;
+            Kind _kind;
+            std::shared_ptr<FormulaFactory> _factory;
+            std::vector<std::shared_ptr<Formula>> _nodes;
+
+            void require(std::size_t n) const;
+            std::uint8_t get_u8();
+            std::uint16_t get_u16();
+            std::uint32_t get_u32();
+            std::uint64_t get_u64();
+            std::string get_string();
+
+            /* Read the arity of a connective.
+             * */
+            Arity get_arity();
+
+            /* Read the number of items that follow, checking
+             * that there are enough bytes for them.
+             * */
+            std::uint32_t get_count(std::size_t item_size);
+
+            std::shared_ptr<Formula> get_fmla();
+            FmlaSet get_fmla_set();
+            std::map<int, std::string> get_values_names();
+            NDTruthTable get_truth_table();
+
+            void expect(Kind kind) const;
+
+        public:
+
+            /* Read the header and the formulas.
+             *
+             * @param data the bytes
+             * @param size the number of bytes
+             * @param factory the factory building the formulas
+             * */
+            BinaryReader(const void* data, std::size_t size,
+                    std::shared_ptr<FormulaFactory> factory = std::make_shared<FormulaFactory>());
+
+            inline Kind kind() const { return _kind; }
+
+            inline decltype(_factory) factory() const { return _factory; }
+
+            FmlaSet read_fmla_set();
+            NDTruthTable read_truth_table();
+            std::shared_ptr<GenMatrix> read_gen_matrix();
+            MultipleConclusionCalculus read_calculus();
+    };
+
+    /**
+     * A read-only memory mapping of a whole file.
+     *
+     * @author Vitor Greati
+     * */
+    class MappedFile {
+
+        private:
+            void* _data = nullptr;
+            std::size_t _size = 0;
+
+        public:
+
+            MappedFile(const std::string& path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            inline const void* data() const { return _data; }
+            inline std::size_t size() const { return _size; }
+    };
+
+};
+
+#endif
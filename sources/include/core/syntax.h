@@ -5,16 +5,59 @@
 #include <atomic>
 #include <memory>
 #include <map>
+#include <deque>
+#include <mutex>
 #include "core/exception.h"
 #include "core/common.h"
 #include "core/utils.h"
 #include <unordered_set>
+#include <unordered_map>
 #include <algorithm>
 #include <sstream>
 #include "assert.h"
 #include <iostream>
 
 namespace ltsy {
+
+    /**
+     * Table giving dense integer ids to symbols, so that
+     * structures keyed by symbols can be indexed by
+     * vectors. There is one global table for connective
+     * symbols and another for variable symbols. Ids are
+     * never released.
+     *
+     * @author Vitor Greati
+     * */
+    class SymbolTable {
+
+        private:
+            std::unordered_map<Symbol, SymbolId> _ids;
+            std::deque<Symbol> _symbols; //> Symbols by id
+            mutable std::mutex _mutex;
+
+        public:
+
+            /* Return the id of a symbol, giving a new one
+             * if the symbol is not in the table.
+             * */
+            SymbolId id(const Symbol& symbol);
+
+            /* Return the symbol with the given id.
+             * */
+            const Symbol& symbol(SymbolId id) const;
+
+            /* Number of symbols in the table.
+             * */
+            std::size_t size() const;
+
+            /* The global table of connective symbols.
+             * */
+            static SymbolTable& connectives();
+
+            /* The global table of variable symbols.
+             * */
+            static SymbolTable& variables();
+    };
     
     /* Represents a connective, with a symbol
      * and an arity.
@@ -25,11 +68,12 @@ namespace ltsy {
         private:
             Symbol _symbol;       //< Connective symbol
             Arity _arity;         //< Connective arity
+            SymbolId _symbol_id;  //< Id of the symbol in the connectives table
         public:
 
             /* Empty constructor.
              * */
-            Connective() {}
+            Connective() : _symbol_id {SymbolTable::connectives().id(_symbol)} {}
 
             /* Construct a connective from its symbol and its
              * arity.
@@ -37,7 +81,8 @@ namespace ltsy {
              * @param symbol
              * @param arity
              * */
-            Connective(const Symbol& _symbol, Arity _arity) : _symbol {_symbol} {
+            Connective(const Symbol& _symbol, Arity _arity) : _symbol {_symbol},
+                _symbol_id {SymbolTable::connectives().id(_symbol)} {
                 if (_arity < 0)
                    throw std::invalid_argument(NEGATIVE_ARITY_EXCEPTION); 
                 this->_arity = _arity;
@@ -49,6 +94,10 @@ namespace ltsy {
              * */
             inline Symbol symbol() const { return _symbol; }
 
+            /* Get the id of the symbol.
+             * */
+            inline SymbolId symbol_id() const { return _symbol_id; }
+
             /* Get connective arity.
              *
              * @return the arity of the connective
@@ -59,7 +108,7 @@ namespace ltsy {
              * and the arity.
              * */
             inline bool operator==(const Connective& other) const {
-                return (_symbol == other._symbol) and (_arity == other._arity);
+                return (_symbol_id == other._symbol_id) and (_arity == other._arity);
             }
 
             /* Different is not equal.
@@ -80,6 +129,8 @@ namespace ltsy {
 
             //> Map relating a symbol with a connective (having the same symbol)
             std::map<Symbol, std::shared_ptr<Connective>> _signature;
+            //> Connectives indexed by symbol id
+            std::vector<std::shared_ptr<Connective>> _by_id;
 
         public:
 
@@ -112,7 +163,13 @@ namespace ltsy {
              * if already exists.
              * */
             void add(std::shared_ptr<Connective> connective) {
-                _signature.insert({connective->symbol(), connective});
+                auto [it, inserted] = _signature.insert({connective->symbol(), connective});
+                if (inserted) {
+                    auto id = connective->symbol_id();
+                    if (id >= _by_id.size())
+                        _by_id.resize(id + 1);
+                    _by_id[id] = connective;
+                }
             }
 
             /**
@@ -120,7 +177,8 @@ namespace ltsy {
              * left-hand side.
              * */
             void join(const Signature& signature) {
-                _signature.insert(signature._signature.begin(), signature._signature.end());
+                for (const auto& [s, c] : signature._signature)
+                    add(c);
             }
 
             /* Produce a subsignature with connectives of
@@ -146,6 +204,14 @@ namespace ltsy {
                 return std::atomic_load(&it->second);
             }
 
+            /* Recover the connective based on the id of its symbol.
+             * */
+            std::shared_ptr<Connective> by_id(SymbolId id) const {
+                if (id >= _by_id.size() or _by_id[id] == nullptr)
+                    throw ltsy::ConnectiveNotPresentException(SymbolTable::connectives().symbol(id));
+                return _by_id[id];
+            }
+
             /* Signature equality.
              * */
             bool operator==(const Signature& other) const {
@@ -197,6 +263,7 @@ namespace ltsy {
     };
 
     class EqualityFormulaVisitor;
+    class FormulaFactory;
 
     /**
      * Represents a propositional formula. It is abstract,
@@ -217,10 +284,25 @@ namespace ltsy {
                 UNKNOWN
             };
 
+            /* Data derived from the structure of the formula,
+             * computed on demand and cached.
+             * */
+            struct Metadata {
+                std::vector<std::uint64_t> variables; //> Bitmask of the variable symbol ids
+                std::vector<std::uint64_t> connectives; //> Bitmask of the connective symbol ids
+                unsigned int depth = 0; //> Connectives in the longest path to a leaf
+            };
+
         protected:
 
             FmlaType _type = FmlaType::UNKNOWN; //> Indicates the formula type
             unsigned int _complexity; //> The formula complexity (occurrence of connectives)
+            std::size_t _hash = 0; //> Structural hash, computed at construction
+            std::size_t _id = 0; //> Identifier given by an interning factory (0 if not interned)
+            std::size_t _factory_serial = 0; //> Serial of the interning factory (0 if not interned)
+            mutable std::shared_ptr<const Metadata> _metadata; //> Set once, by metadata()
+
+            friend class FormulaFactory;
 
         public:
             /* Empty constructor.
@@ -278,7 +360,54 @@ namespace ltsy {
             /* Return the complexity of the formula.
              * */
             decltype(_complexity) complexity() const { return _complexity; }
-            
+
+            /* Return the structural hash of the formula. Equal
+             * formulas have equal hashes.
+             * */
+            inline decltype(_hash) hash() const { return _hash; }
+
+            /* Return the metadata of the formula, computing
+             * it in the first call.
+             * */
+            const Metadata& metadata() const;
+
+            /* Return the depth of the formula.
+             * */
+            inline unsigned int depth() const { return metadata().depth; }
+
+            /* Return the distinct proper subformulas of the formula,
+             * children first, computed by a post-order walk.
+             * */
+            std::vector<std::shared_ptr<Formula>> subformulas() const;
+
+            /* Indicates if the variable with the given symbol
+             * id occurs in the formula.
+             * */
+            inline bool has_variable(SymbolId id) const { 
+                return utils::bitmask_test(metadata().variables, id); 
+            }
+
+            /* Return a pointer sharing the ownership of this formula,
+             * or to a copy of it if it is not owned by a shared pointer.
+             * */
+            std::shared_ptr<Formula> shared() {
+                auto ptr = weak_from_this().lock();
+                return ptr ? ptr : get_formula_copy();
+            }
+
+            /* Return the identifier given by the interning factory,
+             * or 0 if the formula was not interned.
+             * */
+            inline decltype(_id) id() const { return _id; }
+
+            /* Indicates if both formulas were interned by the same
+             * factory, in which case they are structurally equal
+             * iff they have the same id.
+             * */
+            inline bool shares_factory_with(const Formula& other) const {
+                return _factory_serial != 0 and _factory_serial == other._factory_serial;
+            }
+
             /* Produce a copy of this formula.
              * */
             virtual std::shared_ptr<Formula> get_formula_copy() const = 0;
@@ -297,13 +426,16 @@ namespace ltsy {
     class Prop : public Formula {
         private:
             Symbol _symbol; //> The propositional symbol
+            SymbolId _symbol_id; //> Id of the symbol in the variables table
         public:
             
             /* Constructor that accepts the symbol.
              */
-            Prop(const Symbol& _symbol) : _symbol {_symbol} {
+            Prop(const Symbol& _symbol) : _symbol {_symbol}, 
+                _symbol_id {SymbolTable::variables().id(_symbol)} {
                 _type = FmlaType::PROP;
                 _complexity = 0;
+                _hash = std::hash<Symbol>{}(_symbol);
             }
             /* Empty constructor.
              * */
@@ -317,6 +449,10 @@ namespace ltsy {
              * */
             inline Symbol symbol() const { return _symbol; };
 
+            /* Returns the id of the propositional symbol.
+             * */
+            inline SymbolId symbol_id() const { return _symbol_id; };
+
             inline int accept(FormulaVisitor<int>& visitor) {
                 return visitor.visit_prop(this);
             }
@@ -375,13 +511,16 @@ namespace ltsy {
                 this->_connective = _connective;
                 this->_components = _components;
                 _type = FmlaType::COMPOUND;
-                // compute complexity and check whether a compound is null
+                // compute complexity and hash, and check whether a compound is null
                 // TODO is it worth keeping it here?
                 _complexity = 1;
+                _hash = std::hash<Symbol>{}(_connective->symbol());
+                utils::hash_combine(_hash, _connective->arity());
                 for (const auto& c : _components)
-                    if (c != nullptr)
+                    if (c != nullptr) {
                         _complexity += c->complexity();
-                    else
+                        utils::hash_combine(_hash, c->hash());
+                    } else
                         throw std::invalid_argument(NULL_POINTER_TO_COMPOUND);
             }
 
@@ -397,7 +536,7 @@ namespace ltsy {
 
             /* Retrieve the components.
              * */
-            inline decltype(_components) components() const {
+            inline const decltype(_components)& components() const {
                 return _components;
             }
 
@@ -451,6 +590,11 @@ namespace ltsy {
      * */
     using PropSet = std::set<std::shared_ptr<Prop>, utils::DeepSharedPointerComp<Prop>>;
 
+    /* Hash set of pointers to formulas, using their cached
+     * structural hashes.
+     * */
+    using FmlaHashSet = utils::DeepHashSet<std::shared_ptr<Formula>>;
+
     /* Compute the intersection of sets of formulas.
      * */
     FmlaSet intersection(const FmlaSet& s1, const FmlaSet& s2);
@@ -459,6 +603,191 @@ namespace ltsy {
      * */
     FmlaSet difference(const FmlaSet& s1, const FmlaSet& s2);
 
+    /* Compute the intersection of hash sets of formulas.
+     * */
+    FmlaHashSet intersection(const FmlaHashSet& s1, const FmlaHashSet& s2);
+
+    /* Compute the formulas of an ordered set which are also in a hash set.
+     * */
+    FmlaSet intersection(const FmlaSet& s1, const FmlaHashSet& s2);
+
+    /* Compute the difference of hash sets of formulas.
+     * */
+    FmlaHashSet difference(const FmlaHashSet& s1, const FmlaHashSet& s2);
+
+    /* Compute the formulas of an ordered set which are not in a hash set.
+     * */
+    FmlaSet difference(const FmlaSet& s1, const FmlaHashSet& s2);
+
+    /**
+     * A hash-consing factory of formulas. Formulas built
+     * (or interned) through the same factory are kept in a table
+     * keyed by connective and component ids, so that
+     * structurally equal formulas share a single node and
+     * equality reduces to comparing ids.
+     *
+     * The factory keeps its nodes alive and is not thread-safe.
+     *
+     * @author Vitor Greati
+     * */
+    class FormulaFactory {
+
+        private:
+
+            struct CompoundKey {
+                SymbolId symbol;
+                Arity arity;
+                std::vector<std::size_t> components;
+
+                bool operator==(const CompoundKey& other) const {
+                    return arity == other.arity and symbol == other.symbol
+                        and components == other.components;
+                }
+            };
+
+            struct CompoundKeyHash {
+                std::size_t operator()(const CompoundKey& key) const;
+            };
+
+            static std::atomic<std::size_t> _next_serial; //> Serial numbers, distinct among factories
+            std::size_t _serial; //> Serial of this factory
+            std::size_t _next_id = 1; //> Next id to give to a new node
+            std::unordered_map<SymbolId, std::shared_ptr<Prop>> _props;
+            std::unordered_map<CompoundKey, std::shared_ptr<Compound>, CompoundKeyHash> _compounds;
+
+            void register_node(Formula& fmla) {
+                fmla._id = _next_id++;
+                fmla._factory_serial = _serial;
+            }
+
+        public:
+
+            FormulaFactory() : _serial {_next_serial++} {/* empty */}
+
+            /* Copying would produce two factories giving the
+             * same ids to different formulas.
+             * */
+            FormulaFactory(const FormulaFactory&) = delete;
+            FormulaFactory& operator=(const FormulaFactory&) = delete;
+
+            /* Return the unique node of the propositional variable.
+             * */
+            std::shared_ptr<Prop> make_prop(const Symbol& symbol);
+
+            /* Return the unique node of the compound, interning the
+             * components if necessary.
+             * */
+            std::shared_ptr<Formula> make_compound(std::shared_ptr<Connective> connective,
+                    const std::vector<std::shared_ptr<Formula>>& components);
+
+            /* Return the unique node structurally equal to the given formula.
+             * */
+            std::shared_ptr<Formula> intern(std::shared_ptr<Formula> fmla);
+
+            /* Intern every formula of a set.
+             * */
+            FmlaSet intern(const FmlaSet& fmlas);
+
+            /* Return the node structurally equal to the given formula,
+             * or nullptr if there is none. Nothing is created.
+             * */
+            std::shared_ptr<Formula> find(const std::shared_ptr<Formula>& fmla) const;
+
+            /* Return the node of the compound with the given connective
+             * and components (given by their ids), or nullptr if there is none.
+             * */
+            std::shared_ptr<Formula> find_compound(SymbolId symbol, Arity arity, 
+                    const std::vector<std::size_t>& component_ids) const;
+
+            /* Indicates if the formula is a node of this factory.
+             * */
+            inline bool owns(const Formula& fmla) const { return fmla._factory_serial == _serial; }
+
+            /* Number of distinct formulas in the table.
+             * */
+            inline std::size_t size() const { return _props.size() + _compounds.size(); }
+    };
+
+    /**
+     * A flat representation of a collection of formulas.
+     * Nodes are stored contiguously in post-order (children
+     * always come before their parents), each holding
+     * the id of its variable or connective and the range
+     * of its child indices in a single children array.
+     * Structurally equal subformulas are stored once.
+     *
+     * It is meant for evaluating the same formulas many times
+     * with a single loop over the nodes, instead of
+     * going through the visitors.
+     *
+     * @author Vitor Greati
+     * */
+    class FormulaPool {
+
+        public:
+
+            struct Node {
+                Formula::FmlaType type; //> PROP or COMPOUND
+                std::size_t symbol; //> Index in the variable or in the connective table
+                std::size_t first_child; //> Position of the first child index in the children array
+                std::size_t arity; //> Number of children
+            };
+
+        private:
+
+            struct NodeKeyHash {
+                std::size_t operator()(const std::vector<std::size_t>& key) const;
+            };
+
+            std::vector<Node> _nodes; //> Nodes in post-order
+            std::vector<std::size_t> _children; //> Child indices, contiguous for each node
+            std::vector<Prop> _variables; //> Variable table
+            std::vector<std::shared_ptr<Connective>> _connectives; //> Connective table
+            std::unordered_map<SymbolId, std::size_t> _variable_ids;
+            std::unordered_map<SymbolId, std::size_t> _connective_ids;
+            std::unordered_map<std::vector<std::size_t>, std::size_t, NodeKeyHash> _node_ids; //> (type, symbol, children) to node
+
+            std::size_t add_node(Formula::FmlaType type, std::size_t symbol, 
+                    const std::vector<std::size_t>& children);
+
+        public:
+
+            FormulaPool() {/* empty */}
+
+            /* Build a pool holding the given formulas.
+             * */
+            FormulaPool(const FmlaSet& fmlas) {
+                for (const auto& f : fmlas)
+                    add(f);
+            }
+
+            /* Add a formula (and its subformulas) to the pool.
+             *
+             * @return the index of the node representing the formula
+             * */
+            std::size_t add(const std::shared_ptr<Formula>& fmla);
+
+            /* Rebuild the formula represented by a node.
+             * */
+            std::shared_ptr<Formula> formula(std::size_t node) const;
+
+            /* Number of nodes.
+             * */
+            inline std::size_t size() const { return _nodes.size(); }
+
+            inline const Node& node(std::size_t i) const { return _nodes[i]; }
+
+            /* Index of the k-th child of the i-th node.
+             * */
+            inline std::size_t child(std::size_t i, std::size_t k) const { 
+                return _children[_nodes[i].first_child + k]; 
+            }
+
+            inline const decltype(_variables)& variables() const { return _variables; }
+
+            inline const decltype(_connectives)& connectives() const { return _connectives; }
+    };
+
     /* A visitor that tests formula equality.
      * It takes a left-hand side formula A and 
      * accepts by other formulas B, as right-hand side.
@@ -476,25 +805,33 @@ namespace ltsy {
             virtual bool visit_prop(const Prop* prop) const override {
                 if (_left->type() != Formula::FmlaType::PROP)
                     return false;
-                auto left_prop = dynamic_cast<const Prop*>(_left);
-                return left_prop->symbol() == prop->symbol();
+                if (_left->shares_factory_with(*prop))
+                    return _left->id() == prop->id();
+                if (_left->hash() != prop->hash())
+                    return false;
+                auto left_prop = static_cast<const Prop*>(_left);
+                return left_prop->symbol_id() == prop->symbol_id();
             }
 
             virtual bool visit_compound(const Compound* compound) const override {
                 // check formula type
                 if (_left->type() != Formula::FmlaType::COMPOUND)
                     return false; 
-                // check formula complexity
-                if (_left->complexity() != compound->complexity())
+                // interned by the same factory: compare ids
+                if (_left->shares_factory_with(*compound))
+                    return _left->id() == compound->id();
+                // check hash and formula complexity
+                if (_left->hash() != compound->hash() 
+                        or _left->complexity() != compound->complexity())
                     return false;
-                auto left = dynamic_cast<const Compound*>(_left);
+                auto left = static_cast<const Compound*>(_left);
                 // check head connective
-                auto left_conn = left->connective();
+                const auto& left_conn = left->connective();
                 if (*(compound->connective()) != *(left_conn))
                     return false;
                 // check components
-                auto left_comps = left->components();
-                auto right_comps = compound->components();
+                const auto& left_comps = left->components();
+                const auto& right_comps = compound->components();
                 for (int i = 0; i < left_comps.size(); ++i) {
                     EqualityFormulaVisitor eqvis {left_comps[i].get()}; 
                     if (not right_comps[i]->accept(eqvis))
@@ -529,19 +866,23 @@ namespace ltsy {
             virtual bool visit_prop(const Prop* prop) const override {
                 if (_left->type() != Formula::FmlaType::PROP)
                     return true;
-                auto left_prop = dynamic_cast<const Prop*>(_left);
+                if (_left->shares_factory_with(*prop) and _left->id() == prop->id())
+                    return false;
+                auto left_prop = static_cast<const Prop*>(_left);
                 return left_prop->symbol() < prop->symbol();
             }
 
             virtual bool visit_compound(const Compound* compound) const override {
                 if (_left->type() != Formula::FmlaType::COMPOUND)
                    return false; 
-                auto left = dynamic_cast<const Compound*>(_left);
-                auto left_conn = left->connective();
+                if (_left->shares_factory_with(*compound) and _left->id() == compound->id())
+                    return false;
+                auto left = static_cast<const Compound*>(_left);
+                const auto& left_conn = left->connective();
                 if (*(compound->connective()) != *(left_conn))
                     return  left_conn->symbol() < compound->connective()->symbol();
-                auto left_comps = left->components();
-                auto right_comps = compound->components();
+                const auto& left_comps = left->components();
+                const auto& right_comps = compound->components();
                 for (int i = 0; i < left_comps.size(); ++i) {
                     if ((*right_comps[i])==(*left_comps[i]))
                         continue;
@@ -566,15 +907,13 @@ namespace ltsy {
         public:
 
             virtual void visit_prop(Prop* prop) override {
-                this->collected_variables.insert(std::make_shared<Prop>(*prop));
+                this->collected_variables.insert(std::static_pointer_cast<Prop>(prop->shared()));
             }
 
             virtual void visit_compound(Compound* compound) override {
-                auto components = compound->components();
-                std::for_each(components.begin(), components.end(),
-                        [&](std::shared_ptr<Formula> fmla) {
-                           return fmla->accept(*this); 
-                        });
+                for (const auto& s : compound->subformulas())
+                    if (s->type() == Formula::FmlaType::PROP)
+                        this->collected_variables.insert(std::static_pointer_cast<Prop>(s));
             }
 
             /* To be called after being accepted by a formula.
@@ -600,11 +939,9 @@ namespace ltsy {
 
             virtual void visit_compound(Compound* compound) override {
                 collected_signature.add(compound->connective());
-                auto components = compound->components();
-                std::for_each(components.begin(), components.end(),
-                        [&](std::shared_ptr<Formula> fmla) {
-                           return fmla->accept(*this); 
-                        });
+                for (const auto& s : compound->subformulas())
+                    if (s->type() == Formula::FmlaType::COMPOUND)
+                        collected_signature.add(s->connective());
             }
 
             virtual Signature get_collected_signature() {
@@ -622,15 +959,12 @@ namespace ltsy {
 
         public:
             void visit_prop(Prop* prop) override {
-                this->_subfmlas.insert(std::make_shared<Prop>(*prop));
+                this->_subfmlas.insert(prop->shared());
             }
             void visit_compound(Compound* compound) override {
-                this->_subfmlas.insert(std::make_shared<Compound>(*compound));
-                auto components = compound->components();
-                auto connective = compound->connective();
-                for (const auto& c : components) {
-                    c->accept(*this);
-                }
+                this->_subfmlas.insert(compound->shared());
+                const auto subfmlas = compound->subformulas();
+                this->_subfmlas.insert(subfmlas.begin(), subfmlas.end());
             }
             decltype(_subfmlas) subfmlas() {
                 return this->_subfmlas;
@@ -799,8 +1133,8 @@ namespace ltsy {
     class FormulaVarAssignment {
         
         private:
-            //> Maps a propositional variable to a formula
-            std::map<Prop, std::shared_ptr<Formula>> _assignment;
+            //> Maps the id of a propositional variable to a formula (nullptr if unassigned)
+            std::vector<std::shared_ptr<Formula>> _assignment;
 
         public:
 
@@ -808,39 +1142,69 @@ namespace ltsy {
              */
             FormulaVarAssignment() {}
 
-            FormulaVarAssignment(const decltype(_assignment)& assignment)
-                : _assignment {assignment} {};
+            FormulaVarAssignment(const std::map<Prop, std::shared_ptr<Formula>>& assignment) {
+                for (const auto& [p, f] : assignment)
+                    set(p, f);
+            }
 
             /* Equality test for assignments.
              * */
             bool operator==(const FormulaVarAssignment& other) const {
-                return _assignment == other._assignment;
+                auto n = std::max(_assignment.size(), other._assignment.size());
+                for (SymbolId i = 0; i < n; ++i)
+                    if ((*this)(i) != other(i))
+                        return false;
+                return true;
             }
 
             void set(const Prop& prop, std::shared_ptr<Formula> fmla) {
-                _assignment[prop] = fmla;
+                (*this)[prop] = fmla;
             }
 
             std::shared_ptr<Formula>& operator[](const Prop& prop) {
-                return _assignment[prop];
+                auto id = prop.symbol_id();
+                if (id >= _assignment.size())
+                    _assignment.resize(id + 1);
+                return _assignment[id];
+            }
+
+            inline std::shared_ptr<Formula> operator()(const Prop& p) const {
+                return (*this)(p.symbol_id());
+            }
+
+            /* The formula assigned to the variable with the given id.
+             * */
+            inline std::shared_ptr<Formula> operator()(SymbolId id) const {
+                return id < _assignment.size() ? _assignment[id] : nullptr;
             }
 
-            inline std::shared_ptr<Formula> operator()(const Prop& p) {
-                return _assignment[p];
+            /* Bitmask of the ids of the assigned variables.
+             * */
+            std::vector<std::uint64_t> variables() const {
+                std::vector<std::uint64_t> mask;
+                for (SymbolId i = 0; i < _assignment.size(); ++i)
+                    if (_assignment[i] != nullptr)
+                        utils::bitmask_set(mask, i);
+                return mask;
             }
 
             /* The number of variables being assigned.
              */
             int size() const {
-                return _assignment.size();
+                return std::count_if(_assignment.begin(), _assignment.end(), 
+                        [](const auto& f) { return f != nullptr; });
             }
 
             /* Print the assignment.
              */
             std::stringstream print() const {
+                std::map<Symbol, std::shared_ptr<Formula>> by_symbol;
+                for (SymbolId i = 0; i < _assignment.size(); ++i)
+                    if (_assignment[i] != nullptr)
+                        by_symbol[SymbolTable::variables().symbol(i)] = _assignment[i];
                 std::stringstream ss;
-                for (const auto& [k, v] : _assignment) {
-                    ss << k.symbol() << " -> " << (*v) << std::endl;
+                for (const auto& [k, v] : by_symbol) {
+                    ss << k << " -> " << (*v) << std::endl;
                 }
                 return ss;
             }
@@ -940,7 +1304,15 @@ namespace ltsy {
 
     /* Given an assignment of formulas to
      * variables, apply this substitution to
-     * a given formula.
+     * a given formula. Unassigned variables
+     * are left in place.
+     *
+     * Subtrees with no substituted variable are
+     * returned as they are (or interned, if a factory is given),
+     * and the results for compounds are memoized, so that
+     * accepting many formulas with the same evaluator
+     * (e.g. all the formulas of a sequent) shares the work and
+     * the resulting nodes.
      *
      * @author Vitor Greati
      * */
@@ -948,25 +1320,53 @@ namespace ltsy {
     
         private:
             FormulaVarAssignment _assignment; //> The assignment to be applied
+            std::shared_ptr<FormulaFactory> _factory; //> If given, results are interned in it
+            std::vector<std::uint64_t> _assigned_variables; //> Bitmask of the assigned variable ids
+            //> Results by visited node; the node is kept alive so that its address is not reused
+            std::unordered_map<const Formula*, 
+                std::pair<std::shared_ptr<Formula>, std::shared_ptr<Formula>>> _memo;
+
+            std::shared_ptr<Formula> memoize(Formula* fmla, std::shared_ptr<Formula> result) {
+                auto owner = fmla->weak_from_this().lock();
+                if (owner)
+                    _memo.insert({fmla, {owner, result}});
+                return result;
+            }
 
         public:
 
-            SubstitutionEvaluator(const decltype(_assignment)& assignment)
-                : _assignment {assignment} {}
+            SubstitutionEvaluator(const decltype(_assignment)& assignment,
+                    decltype(_factory) factory = nullptr)
+                : _assignment {assignment}, _factory {factory},
+                _assigned_variables {assignment.variables()} {}
 
             std::shared_ptr<Formula> visit_prop(Prop* prop) override {
-                return _assignment(*prop);
+                auto fmla = _assignment(*prop);
+                if (fmla == nullptr)
+                    fmla = prop->shared();
+                if (_factory)
+                    return _factory->intern(fmla);
+                return fmla;
             }
 
             std::shared_ptr<Formula> visit_compound(Compound* compound) override {
-                auto components = compound->components();
-                auto connective = compound->connective();
-                std::vector<std::shared_ptr<Formula>> new_components;
-                for (const auto& c : components) {
-                    auto cn = c->accept(*this); 
-                    new_components.push_back(cn);
+                auto it = _memo.find(compound);
+                if (it != _memo.end())
+                    return it->second.second;
+                // nothing to substitute below this node
+                if (not utils::bitmask_intersects(compound->metadata().variables, _assigned_variables)) {
+                    if (_factory)
+                        return memoize(compound, _factory->intern(compound->shared()));
+                    return compound->shared();
                 }
-                return std::make_shared<Compound>(connective, new_components);
+                const auto& components = compound->components();
+                std::vector<std::shared_ptr<Formula>> new_components;
+                new_components.reserve(components.size());
+                for (const auto& c : components)
+                    new_components.push_back(c->accept(*this));
+                if (_factory)
+                    return memoize(compound, _factory->make_compound(compound->connective(), new_components));
+                return memoize(compound, std::make_shared<Compound>(compound->connective(), new_components));
             }
 
     };
@@ -975,5 +1375,13 @@ namespace ltsy {
      */
     bool is_subset(const FmlaSet& f1, const FmlaSet& f2);
 
+    /* Check if a hash set of formulas is a subset of another.
+     */
+    bool is_subset(const FmlaHashSet& f1, const FmlaHashSet& f2);
+
+    /* Check if an ordered set of formulas is a subset of a hash set.
+     */
+    bool is_subset(const FmlaSet& f1, const FmlaHashSet& f2);
+
 }
 #endif
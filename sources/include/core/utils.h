@@ -2,6 +2,7 @@
 #define __CORE_UTILS__
 
 #include <array>
+#include <cstdint>
 #include <vector>
 #include <unordered_set>
 #include <memory>
@@ -24,6 +25,29 @@ namespace ltsy::utils {
     };
 
 
+    template<typename T>
+    struct DeepSharedPointerHash {
+        std::size_t operator()(const std::shared_ptr<T>& p) const {
+            return p->hash(); 
+        }
+    };
+
+    template<typename T>
+    struct DeepSharedPointerEqual {
+        bool operator()(const std::shared_ptr<T>& lhs, const std::shared_ptr<T>& rhs) const {
+            return *lhs == *rhs; 
+        }
+    };
+
+    /* Hash set of pointers, compared by their contents. It has the
+     * template shape of std::set<T, Comp> (the comparator is ignored),
+     * so that it can replace it as a container template argument.
+     * */
+    template<typename PtrT, typename... Ignored>
+    using DeepHashSet = std::unordered_set<PtrT, 
+          DeepSharedPointerHash<typename PtrT::element_type>, 
+          DeepSharedPointerEqual<typename PtrT::element_type>>;
+
     /* Compare two sets of pointers for equality.
      * */
     template<typename T>
@@ -45,11 +69,138 @@ namespace ltsy::utils {
         return is_subset(s1, s2) and is_subset(s2,s1);
     }
 
+    /* Check if a hash set of pointers is a subset of another.
+     * */
+    template<typename T>
+    bool is_subset(const DeepHashSet<std::shared_ptr<T>>& s1,
+                const DeepHashSet<std::shared_ptr<T>>& s2) {
+        if (s1.size() > s2.size()) return false;
+        for (const auto& s : s1)
+            if (s2.find(s) == s2.end())
+                return false;
+        return true;
+    }
+
+    /* Compare two hash sets of pointers for equality.
+     * */
+    template<typename T>
+    bool equals(const DeepHashSet<std::shared_ptr<T>>& s1,
+                const DeepHashSet<std::shared_ptr<T>>& s2) {
+        if (s1.size() != s2.size()) return false;
+        return is_subset(s1, s2);
+    }
+
+    /* Mix the hash of a value into a seed (boost-like).
+     * */
+    inline void hash_combine(std::size_t& seed, std::size_t value) {
+        seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+    }
+
+    /* Dynamically sized bitmasks, stored as vectors of 64-bit words.
+     * */
+    inline void bitmask_set(std::vector<std::uint64_t>& mask, std::size_t i) {
+        if (i / 64 >= mask.size())
+            mask.resize(i / 64 + 1, 0);
+        mask[i / 64] |= std::uint64_t{1} << (i % 64);
+    }
+
+    inline bool bitmask_test(const std::vector<std::uint64_t>& mask, std::size_t i) {
+        return i / 64 < mask.size() and (mask[i / 64] >> (i % 64)) & 1;
+    }
+
+    inline void bitmask_union(std::vector<std::uint64_t>& mask, const std::vector<std::uint64_t>& other) {
+        if (other.size() > mask.size())
+            mask.resize(other.size(), 0);
+        for (std::size_t w = 0; w < other.size(); ++w)
+            mask[w] |= other[w];
+    }
+
+    inline bool bitmask_intersects(const std::vector<std::uint64_t>& mask, const std::vector<std::uint64_t>& other) {
+        for (std::size_t w = 0; w < mask.size() and w < other.size(); ++w)
+            if (mask[w] & other[w])
+                return true;
+        return false;
+    }
+
+    inline bool bitmask_is_subset(const std::vector<std::uint64_t>& mask, const std::vector<std::uint64_t>& other) {
+        for (std::size_t w = 0; w < mask.size(); ++w)
+            if (mask[w] & ~(w < other.size() ? other[w] : 0))
+                return false;
+        return true;
+    }
+
+    /* Cursor over the tuples of {0,...,nvalues-1}^arity in
+     * lexicographical order, that is, over the rows of a truth
+     * table. Advancing it updates the digits in place, like
+     * an odometer, without allocating.
+     * */
+    class RowCursor {
+        private:
+            int _nvalues = 0;
+            std::vector<int> _digits;
+            int _position = 0;
+            bool _done = true;
+
+        public:
+
+            RowCursor() {/* empty */}
+
+            RowCursor(int nvalues, int arity, int position = 0) 
+                : _nvalues {nvalues}, _digits (arity, 0) {
+                seek(position);
+            }
+
+            /* The digits of the current row.
+             * */
+            inline const std::vector<int>& tuple() const { return _digits; }
+
+            inline int operator[](int i) const { return _digits[i]; }
+
+            inline int position() const { return _position; }
+
+            inline int arity() const { return _digits.size(); }
+
+            /* Indicates if the cursor went past the last row.
+             * */
+            inline bool done() const { return _done; }
+
+            /* Advance to the next row.
+             *
+             * @return false if the cursor was at the last row
+             * */
+            bool next() {
+                ++_position;
+                for (int i = int(_digits.size()) - 1; i >= 0; --i) {
+                    if (++_digits[i] < _nvalues)
+                        return true;
+                    _digits[i] = 0;
+                }
+                _done = true;
+                return false;
+            }
+
+            /* Move to the row at a given position.
+             * */
+            void seek(int position) {
+                _position = position;
+                for (int i = int(_digits.size()) - 1; i >= 0; --i) {
+                    _digits[i] = _nvalues > 0 ? position % _nvalues : 0;
+                    position = _nvalues > 0 ? position / _nvalues : 1;
+                }
+                _done = position > 0;
+            }
+
+            inline void reset() { seek(0); }
+    };
+
     std::vector<int> tuple_from_position(int nvalues, int arity, int position);
 
     int position_from_tuple(int nvalues, int arity, const std::vector<int>& tuple);
 
-    int compute_number_of_functions(int nvalues, int arity);
+    /* Number of functions {0,...,nvalues-1}^arity -> {0,...,nvalues-1},
+     * throwing std::overflow_error when it does not fit in 64 bits.
+     * */
+    std::uint64_t compute_number_of_functions(int nvalues, int arity);
 
     int compute_number_of_rows(int nvalues, int arity);
 
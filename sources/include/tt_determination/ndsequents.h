@@ -28,76 +28,46 @@ namespace ltsy {
 
         private:
             int _nvalues;
-            std::set<int> _all_values;
+            ValueMask _all_values;
             Connective _connective;
             std::vector<Prop> _props;
             std::shared_ptr<Compound> _compound;
-            TruthTable<std::set<int>> _table;
+            NDMaskTruthTable _table;
             std::vector<CognitiveAttitude> _attitudes;
-
-            void _remove_determinants_by_pos_attitude(const CognitiveAttitude& attitude, int pos, 
-                    std::set<Determinant<std::set<int>>>& determinants) {
-                for (auto it = determinants.begin(); it != determinants.end();) {
-                    auto det_args = (*it).get_args(); 
-                    if (attitude.values.find(det_args[pos]) == attitude.values.end())
-                           it = determinants.erase(it); 
-                    else it++;
-                } 
-            }
-
-            bool _determine_by_dimension(int dimension, const NdSequent<std::set>& sequent, 
-                    std::set<Determinant<std::set<int>>>& determinants) {
-                for (int i = 0; i < _props.size(); ++i) {
-                    Formula& p = _props[i];
-                    if (sequent.is_in(dimension, p))
-                        _remove_determinants_by_pos_attitude(_attitudes[dimension], i, determinants);
-                }
-                if (sequent.is_in(dimension, *_compound)) {
-                    for (auto it = determinants.begin(); it != determinants.end();) {
-                        auto det = (*it);
-                        std::set<int> cm_set;
-                        std::set_difference(_all_values.begin(), _all_values.end(),
-                                            _attitudes[dimension].values.begin(), 
-                                            _attitudes[dimension].values.end(), 
-                                            std::inserter(cm_set, cm_set.end()));
-                        std::set<int> new_cm_set;
-                        // ugly conversion unord set to set
-                        std::set<int> det_val_set;
-                        for (auto e : det.get_last())
-                            det_val_set.insert(e);
-                        std::set_difference(
-                                det_val_set.begin(), det_val_set.end(),
-                                cm_set.begin(), cm_set.end(),
-                                std::inserter(new_cm_set, new_cm_set.end()));
-                        std::set<int> s (new_cm_set.begin(), new_cm_set.end());
-                        det.set_last(s);
-                        it = determinants.erase(it);
-                        determinants.insert(it, det);
-                    }
-                    return true;
-                }
-                return false;
-            }
+            std::vector<ValueMask> _attitudes_values;
 
             /**
              * Impose conditions over the table given by a sequent.
              *
+             * The counter-models of the sequent are the inputs whose
+             * arguments satisfy the attitudes of the positions where
+             * the corresponding variables occur, giving outputs that
+             * satisfy the attitudes of the positions where the compound
+             * occurs. These outputs are removed from the table.
+             *
              * @param sequent the sequent
              * */
             void _determine_by_sequent(const NdSequent<std::set>& sequent) {
                 auto dimension = sequent.dimension();     
-                // work to find the determinants that lead to counter-models
-                auto counter_model_determinants = 
-                    generate_fully_nd_table(_nvalues, _connective.arity()).get_determinants();
-                bool compound_has_appeared = false;
-                // produce counter-model determinants
-                for (auto i = 0; i < dimension; ++i)
-                    compound_has_appeared |= _determine_by_dimension(i, sequent, counter_model_determinants); 
-                _table.update(counter_model_determinants, 
-                        [](std::set<int> current, std::set<int> counter_models) -> std::set<int> {
-                            return utils::set_difference(current, counter_models);
-                        }
-                );
+                // allowed values of each argument, and of the output, in a counter-model
+                std::vector<ValueMask> args_values (_props.size(), _all_values);
+                ValueMask counter_model_values = _all_values;
+                for (auto i = 0; i < dimension; ++i) {
+                    for (int k = 0; k < _props.size(); ++k) {
+                        Formula& p = _props[k];
+                        if (sequent.is_in(i, p))
+                            args_values[k] &= _attitudes_values[i];
+                    }
+                    if (sequent.is_in(i, *_compound))
+                        counter_model_values &= _attitudes_values[i];
+                }
+                for (utils::RowCursor row {_nvalues, static_cast<int>(_props.size())}; not row.done(); row.next()) {
+                    bool counter_model_input = true;
+                    for (int k = 0; k < row.arity() and counter_model_input; ++k)
+                        counter_model_input = args_values[k].contains(row[k]);
+                    if (counter_model_input)
+                        _table.set(row.position(), _table.at(row.position()) - counter_model_values);
+                }
             }
 
         public:
@@ -117,12 +87,13 @@ namespace ltsy {
                 _compound = std::make_shared<Compound>(std::make_shared<Connective>(_connective), props_args);
                 // start from a fully nd table
                 if (start_table == std::nullopt)
-                    _table = generate_fully_nd_table(_nvalues, _connective.arity());
+                    _table = NDMaskTruthTable {generate_fully_nd_table(_nvalues, _connective.arity())};
                 else
-                    _table = start_table.value();
+                    _table = NDMaskTruthTable {start_table.value()};
                 // populate set of values
-                for (auto i = 0; i < _nvalues; ++i) 
-                    _all_values.insert(i);
+                _all_values = ValueMask::all(_nvalues);
+                for (const auto& attitude : _attitudes)
+                    _attitudes_values.emplace_back(attitude.values);
             }
 
             NdSequentTruthTableDeterminizer(
@@ -141,7 +112,7 @@ namespace ltsy {
                     _determine_by_sequent(s);
             } 
 
-            decltype(_table) table() const { return _table; }
+            NDTruthTable table() const { return _table.to_set_table(); }
 
     };
 
@@ -48,7 +48,7 @@ namespace ltsy {
 
             std::vector<NdSequent<std::set>> axiomatize(const NDTruthTable& table) {
                 std::vector<NdSequent<std::set>> sequents;
-                for (const auto& d : table.get_determinants()) {
+                for (const auto& d : table.determinants()) {
                    sequents_from_determinants(d, sequents); 
                 } 
                 return sequents;
@@ -56,9 +56,9 @@ namespace ltsy {
 
         private:
 
-            void sequents_from_determinants(const Determinant<std::set<int>>& det,
+            void sequents_from_determinants(const DeterminantView<std::set<int>>& det,
                     std::vector<NdSequent<std::set>>& sequents) {
-                auto response_set = det.get_last(); 
+                const auto& response_set = det.get_last(); 
                 auto avoid_set = utils::set_difference(this->_all_values, response_set);
                 auto avoid_set_size = avoid_set.size();
                 auto all_values_size = _all_values.size();
@@ -83,7 +83,7 @@ namespace ltsy {
                 }
             };
 
-            void place_variables(NdSequent<std::set>& seq, const Determinant<std::set<int>>& det) {
+            void place_variables(NdSequent<std::set>& seq, const DeterminantView<std::set<int>>& det) {
                 const auto& det_args = det.get_args();
                 for (size_t i {0}; i < det_args.size(); ++i) {
                     auto dv = det_args[i];
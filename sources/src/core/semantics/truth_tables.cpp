@@ -45,8 +45,9 @@ namespace ltsy {
             return values_map.find(v) != values_map.end() ? values_map.find(v)->second : std::to_string(v); 
         };
         std::stringstream ss;
-        for (auto i = 0; i < _images.size(); ++i) {
-            auto row = utils::tuple_from_position(_nvalues, _arity, i);
+        utils::RowCursor cursor {_nvalues, _arity};
+        for (auto i = 0; i < _images.size(); ++i, cursor.next()) {
+            const auto& row = cursor.tuple();
             for (auto it = row.cbegin(); it != row.cend(); it++) {
                 ss << std::setw(5) << get_or_default(*it);
                 if (std::next(it) != row.cend())
@@ -69,8 +70,9 @@ namespace ltsy {
     template<typename CellType>
     std::stringstream TruthTableBase<CellType>::print(std::function<void(std::stringstream&, const CellType&)> cell_printer) const {
         std::stringstream ss;
-        for (auto i = 0; i < _images.size(); ++i) {
-            auto row = utils::tuple_from_position(_nvalues, _arity, i);
+        utils::RowCursor cursor {_nvalues, _arity};
+        for (auto i = 0; i < _images.size(); ++i, cursor.next()) {
+            const auto& row = cursor.tuple();
             for (auto it = row.cbegin(); it != row.cend(); it++) {
                 ss << (*it);
                 if (std::next(it) != row.cend())
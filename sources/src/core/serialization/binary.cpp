@@ -0,0 +1,456 @@
+#include "core/serialization/binary.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ltsy::binary {
+
+    void BinaryWriter::put_u16(std::string& out, std::uint16_t v) const {
+        for (int i = 0; i < 2; ++i)
+            put_u8(out, (v >> (8 * i)) & 0xFF);
+    }
+
+    void BinaryWriter::put_u32(std::string& out, std::uint32_t v) const {
+        for (int i = 0; i < 4; ++i)
+            put_u8(out, (v >> (8 * i)) & 0xFF);
+    }
+
+    void BinaryWriter::put_u64(std::string& out, std::uint64_t v) const {
+        for (int i = 0; i < 8; ++i)
+            put_u8(out, (v >> (8 * i)) & 0xFF);
+    }
+
+    void BinaryWriter::put_string(std::string& out, const std::string& s) const {
+        put_u32(out, s.size());
+        out += s;
+    }
+
+    void BinaryWriter::put_fmla(const std::shared_ptr<Formula>& fmla) {
+        put_u32(_body, fmla == nullptr ? NO_FORMULA : _pool.add(fmla));
+    }
+
+    void BinaryWriter::put_fmla_set(const FmlaSet& fmlas) {
+        put_u32(_body, fmlas.size());
+        for (const auto& f : fmlas)
+            put_fmla(f);
+    }
+
+    void BinaryWriter::put_values_names(const std::map<int, std::string>& names) {
+        put_u32(_body, names.size());
+        for (const auto& [v, name] : names) {
+            put_u32(_body, v);
+            put_string(_body, name);
+        }
+    }
+
+    void BinaryWriter::put_truth_table(const NDTruthTable& table) {
+        put_u32(_body, table.nvalues());
+        put_u32(_body, table.arity());
+        put_string(_body, table.name());
+        put_fmla(table.fmla());
+        put_values_names(table.get_values_names());
+        for (int i = 0; i < table.number_of_rows(); ++i)
+            put_u64(_body, ValueMask {table.at(i)}.bits());
+    }
+
+    std::string BinaryWriter::finish(Kind kind) {
+        std::string out;
+        put_u32(out, MAGIC);
+        put_u16(out, VERSION);
+        put_u16(out, static_cast<std::uint16_t>(kind));
+        put_u32(out, _pool.variables().size());
+        for (const auto& p : _pool.variables())
+            put_string(out, p.symbol());
+        put_u32(out, _pool.connectives().size());
+        for (const auto& c : _pool.connectives()) {
+            put_string(out, c->symbol());
+            put_u32(out, c->arity());
+        }
+        put_u32(out, _pool.size());
+        for (std::size_t i = 0; i < _pool.size(); ++i) {
+            const auto& node = _pool.node(i);
+            put_u8(out, node.type == Formula::FmlaType::PROP ? 0 : 1);
+            put_u32(out, node.symbol);
+            put_u32(out, node.arity);
+            for (std::size_t k = 0; k < node.arity; ++k)
+                put_u32(out, _pool.child(i, k));
+        }
+        out += _body;
+        _pool = FormulaPool {};
+        _body.clear();
+        return out;
+    }
+
+    std::string BinaryWriter::write(const FmlaSet& fmlas) {
+        put_fmla_set(fmlas);
+        return finish(Kind::FMLA_SET);
+    }
+
+    std::string BinaryWriter::write(const NDTruthTable& table) {
+        put_truth_table(table);
+        return finish(Kind::TRUTH_TABLE);
+    }
+
+    std::string BinaryWriter::write(const GenMatrix& matrix) {
+        auto values = matrix.values();
+        put_u32(_body, values.size());
+        for (auto v : values)
+            put_u32(_body, v);
+        auto distinguished_sets = matrix.distinguished_sets();
+        put_u32(_body, distinguished_sets.size());
+        for (const auto& dset : distinguished_sets)
+            put_u64(_body, ValueMask {dset}.bits());
+        put_values_names(matrix.val_to_str());
+        auto signature = matrix.signature();
+        put_u8(_body, signature != nullptr);
+        if (signature != nullptr) {
+            std::uint32_t count = 0;
+            for (auto it = signature->begin(); it != signature->end(); ++it)
+                ++count;
+            put_u32(_body, count);
+            for (auto [symbol, connective] : *signature) {
+                put_string(_body, symbol);
+                put_u32(_body, connective->arity());
+            }
+        }
+        auto interpretation = matrix.interpretation();
+        put_u8(_body, interpretation != nullptr);
+        if (interpretation != nullptr) {
+            std::uint32_t count = 0;
+            for (auto it = interpretation->begin(); it != interpretation->end(); ++it)
+                ++count;
+            put_u32(_body, count);
+            for (const auto& [symbol, ti] : *interpretation) {
+                put_string(_body, symbol);
+                put_truth_table(*ti->truth_table());
+            }
+        }
+        return finish(Kind::GEN_MATRIX);
+    }
+
+    std::string BinaryWriter::write(const MultipleConclusionCalculus& calculus) {
+        auto rules = calculus.rules();
+        put_u32(_body, rules.size());
+        for (const auto& rule : rules) {
+            put_string(_body, rule.name());
+            put_string(_body, rule.group());
+            auto sequent = rule.sequent();
+            put_u32(_body, sequent.dimension());
+            for (int i = 0; i < sequent.dimension(); ++i)
+                put_fmla_set(sequent[i]);
+            auto corresp = rule.prem_conc_pos_corresp();
+            put_u32(_body, corresp.size());
+            for (const auto& [p, c] : corresp) {
+                put_u32(_body, p);
+                put_u32(_body, c);
+            }
+        }
+        return finish(Kind::CALCULUS);
+    }
+
+    void BinaryWriter::write_file(const std::string& path, const std::string& bytes) {
+        std::ofstream file {path, std::ios::binary};
+        if (not file)
+            throw ParseException("cannot open " + path + " for writing");
+        file.write(bytes.data(), bytes.size());
+    }
+
+    BinaryReader::BinaryReader(const void* data, std::size_t size, std::shared_ptr<FormulaFactory> factory)
+        : _data {static_cast<const unsigned char*>(data)}, _size {size}, _factory {factory} {
+        if (get_u32() != MAGIC)
+            throw ParseException("not a logicantsy binary file");
+        auto version = get_u16();
+        if (version != VERSION)
+            throw ParseException("unsupported binary format version " + std::to_string(version));
+        _kind = static_cast<Kind>(get_u16());
+        std::vector<Symbol> variables (get_count(4));
+        for (auto& v : variables)
+            v = get_string();
+        std::vector<std::shared_ptr<Connective>> connectives (get_count(8));
+        for (auto& c : connectives) {
+            auto symbol = get_string();
+            c = std::make_shared<Connective>(symbol, get_arity());
+        }
+        _nodes.resize(get_count(9));
+        for (std::size_t i = 0; i < _nodes.size(); ++i) {
+            auto type = get_u8();
+            auto symbol = get_u32();
+            auto arity = get_u32();
+            if (type == 0) {
+                if (symbol >= variables.size() or arity != 0)
+                    throw ParseException("invalid variable node " + std::to_string(i));
+                _nodes[i] = _factory->make_prop(variables[symbol]);
+                continue;
+            }
+            if (type != 1)
+                throw ParseException("invalid type of node " + std::to_string(i));
+            if (symbol >= connectives.size() or arity != std::uint32_t(connectives[symbol]->arity()))
+                throw ParseException("invalid compound node " + std::to_string(i));
+            // the children must be present before they are allocated
+            require(4 * std::size_t(arity));
+            std::vector<std::shared_ptr<Formula>> components (arity);
+            for (auto& c : components) {
+                auto child = get_u32();
+                // children come before their parents
+                if (child >= i)
+                    throw ParseException("invalid child of node " + std::to_string(i));
+                c = _nodes[child];
+            }
+            _nodes[i] = _factory->make_compound(connectives[symbol], components);
+        }
+    }
+
+    void BinaryReader::require(std::size_t n) const {
+        if (n > _size - _offset)
+            throw ParseException("unexpected end of binary data at byte " + std::to_string(_offset));
+    }
+
+    std::uint8_t BinaryReader::get_u8() {
+        require(1);
+        return _data[_offset++];
+    }
+
+    std::uint16_t BinaryReader::get_u16() {
+        require(2);
+        std::uint16_t v = _data[_offset] | (_data[_offset + 1] << 8);
+        _offset += 2;
+        return v;
+    }
+
+    std::uint32_t BinaryReader::get_u32() {
+        require(4);
+        std::uint32_t v = 0;
+        for (int i = 3; i >= 0; --i)
+            v = (v << 8) | _data[_offset + i];
+        _offset += 4;
+        return v;
+    }
+
+    std::uint64_t BinaryReader::get_u64() {
+        require(8);
+        std::uint64_t v = 0;
+        for (int i = 7; i >= 0; --i)
+            v = (v << 8) | _data[_offset + i];
+        _offset += 8;
+        return v;
+    }
+
+    std::uint32_t BinaryReader::get_count(std::size_t item_size) {
+        auto count = get_u32();
+        require(count * item_size);
+        return count;
+    }
+
+    Arity BinaryReader::get_arity() {
+        auto arity = get_u32();
+        if (arity > std::uint32_t(INT_MAX))
+            throw ParseException("invalid connective arity " + std::to_string(arity));
+        return arity;
+    }
+
+    std::string BinaryReader::get_string() {
+        auto length = get_u32();
+        require(length);
+        std::string s {reinterpret_cast<const char*>(_data + _offset), length};
+        _offset += length;
+        return s;
+    }
+
+    std::shared_ptr<Formula> BinaryReader::get_fmla() {
+        auto node = get_u32();
+        if (node == NO_FORMULA)
+            return nullptr;
+        if (node >= _nodes.size())
+            throw ParseException("invalid formula reference " + std::to_string(node));
+        return _nodes[node];
+    }
+
+    FmlaSet BinaryReader::get_fmla_set() {
+        FmlaSet fmlas;
+        auto count = get_u32();
+        for (std::uint32_t i = 0; i < count; ++i) {
+            auto fmla = get_fmla();
+            // only optional formulas may be absent
+            if (fmla == nullptr)
+                throw ParseException("missing formula in a set in binary data");
+            fmlas.insert(fmla);
+        }
+        return fmlas;
+    }
+
+    std::map<int, std::string> BinaryReader::get_values_names() {
+        std::map<int, std::string> names;
+        auto count = get_u32();
+        for (std::uint32_t i = 0; i < count; ++i) {
+            int v = get_u32();
+            names[v] = get_string();
+        }
+        return names;
+    }
+
+    NDTruthTable BinaryReader::get_truth_table() {
+        auto nvalues = get_u32();
+        auto arity = get_u32();
+        if (nvalues < 1 or nvalues > std::uint32_t(ValueMask::MAX_VALUES))
+            throw ParseException("invalid number of values " + std::to_string(nvalues) + " of a truth table");
+        // with two values or more, larger arities have more rows than can be addressed
+        if (arity > 8 * sizeof(std::size_t))
+            throw ParseException("invalid arity " + std::to_string(arity) + " of a truth table");
+        auto name = get_string();
+        auto fmla = get_fmla();
+        auto values_names = get_values_names();
+        // the rows must be present before the table is allocated, 
+        // which also keeps their number from overflowing
+        std::size_t rows = 1;
+        require(8);
+        for (std::uint32_t k = 0; k < arity; ++k) {
+            rows *= nvalues;
+            require(8 * rows);
+        }
+        NDTruthTable table {static_cast<int>(nvalues), static_cast<int>(arity), fmla};
+        const std::uint64_t stray = nvalues == std::uint32_t(ValueMask::MAX_VALUES) ? 0 : ~((std::uint64_t(1) << nvalues) - 1);
+        for (std::size_t i = 0; i < rows; ++i) {
+            auto mask = get_u64();
+            if (mask & stray)
+                throw ParseException("invalid image of row " + std::to_string(i) + " of a truth table");
+            table.set(i, ValueMask {mask}.to_set());
+        }
+        table.set_name(name);
+        table.set_values_names(values_names);
+        return table;
+    }
+
+    void BinaryReader::expect(Kind kind) const {
+        if (_kind != kind)
+            throw ParseException("unexpected kind of artifact in binary data");
+    }
+
+    FmlaSet BinaryReader::read_fmla_set() {
+        expect(Kind::FMLA_SET);
+        return get_fmla_set();
+    }
+
+    NDTruthTable BinaryReader::read_truth_table() {
+        expect(Kind::TRUTH_TABLE);
+        return get_truth_table();
+    }
+
+    std::shared_ptr<GenMatrix> BinaryReader::read_gen_matrix() {
+        expect(Kind::GEN_MATRIX);
+        std::set<int> values;
+        auto nvalues = get_u32();
+        for (std::uint32_t i = 0; i < nvalues; ++i) {
+            auto v = get_u32();
+            if (v >= std::uint32_t(ValueMask::MAX_VALUES))
+                throw ParseException("invalid value " + std::to_string(v) + " of a matrix");
+            values.insert(v);
+        }
+        std::vector<std::set<int>> distinguished_sets (get_count(8));
+        for (auto& dset : distinguished_sets) {
+            dset = ValueMask {get_u64()}.to_set();
+            if (not std::includes(values.begin(), values.end(), dset.begin(), dset.end()))
+                throw ParseException("distinguished set not contained in the values in binary data");
+        }
+        auto val_to_str = get_values_names();
+        std::shared_ptr<Signature> signature = nullptr;
+        if (get_u8()) {
+            signature = std::make_shared<Signature>();
+            auto count = get_u32();
+            for (std::uint32_t i = 0; i < count; ++i) {
+                auto symbol = get_string();
+                signature->add(std::make_shared<Connective>(symbol, get_arity()));
+            }
+        }
+        std::shared_ptr<SignatureTruthInterp<std::set<int>>> interpretation = nullptr;
+        if (get_u8()) {
+            if (signature == nullptr)
+                throw ParseException("interpretation without a signature in binary data");
+            interpretation = std::make_shared<SignatureTruthInterp<std::set<int>>>(signature);
+            auto count = get_u32();
+            for (std::uint32_t i = 0; i < count; ++i) {
+                auto symbol = get_string();
+                auto table = std::make_shared<NDTruthTable>(get_truth_table());
+                std::shared_ptr<Connective> connective;
+                try {
+                    connective = (*signature)[symbol];
+                } catch (ConnectiveNotPresentException&) {
+                    throw ParseException("interpretation of connective " + symbol + " not in the signature");
+                }
+                if (table->nvalues() != int(values.size()) or table->arity() != connective->arity())
+                    throw ParseException("truth table of " + symbol + " does not fit the matrix");
+                try {
+                    interpretation->try_interpret(std::make_shared<TruthInterp<std::set<int>>>(connective, table));
+                } catch (std::invalid_argument&) {
+                    throw ParseException("connective " + symbol + " interpreted twice");
+                }
+            }
+        }
+        // the complements were stored with the sets
+        auto matrix = std::make_shared<GenMatrix>(values, distinguished_sets, signature, interpretation, false);
+        matrix->set_val_to_str(val_to_str);
+        std::map<std::string, int> str_to_val;
+        for (const auto& [v, s] : val_to_str)
+            str_to_val[s] = v;
+        matrix->set_str_to_val(str_to_val);
+        return matrix;
+    }
+
+    MultipleConclusionCalculus BinaryReader::read_calculus() {
+        expect(Kind::CALCULUS);
+        std::vector<MultipleConclusionRule> rules;
+        auto nrules = get_u32();
+        for (std::uint32_t r = 0; r < nrules; ++r) {
+            auto name = get_string();
+            auto group = get_string();
+            // each position holds at least the size of its set
+            NdSequent<std::set> sequent (get_count(4));
+            for (int i = 0; i < sequent.dimension(); ++i)
+                sequent[i] = get_fmla_set();
+            std::vector<std::pair<int,int>> corresp (get_count(8));
+            for (auto& [p, c] : corresp) {
+                auto premise_position = get_u32();
+                auto conclusion_position = get_u32();
+                if (premise_position >= std::uint32_t(sequent.dimension()) 
+                        or conclusion_position >= std::uint32_t(sequent.dimension()))
+                    throw ParseException("invalid sequent position in rule " + name);
+                p = premise_position;
+                c = conclusion_position;
+            }
+            MultipleConclusionRule rule {name, sequent, corresp};
+            rule.set_group(group);
+            rules.push_back(rule);
+        }
+        return MultipleConclusionCalculus {rules};
+    }
+
+    MappedFile::MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw ParseException("cannot open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            ::close(fd);
+            throw ParseException("cannot read the size of " + path);
+        }
+        _size = st.st_size;
+        if (_size > 0) {
+            _data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (_data == MAP_FAILED) {
+                _data = nullptr;
+                ::close(fd);
+                throw ParseException("cannot map " + path);
+            }
+        }
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (_data != nullptr)
+            ::munmap(_data, _size);
+    }
+
+};
@@ -10,12 +10,106 @@ namespace ltsy {
         return os;
     }
 
+    SymbolId SymbolTable::id(const Symbol& symbol) {
+        std::lock_guard<std::mutex> lock {_mutex};
+        auto [it, inserted] = _ids.insert({symbol, _symbols.size()});
+        if (inserted)
+            _symbols.push_back(symbol);
+        return it->second;
+    }
+
+    const Symbol& SymbolTable::symbol(SymbolId id) const {
+        std::lock_guard<std::mutex> lock {_mutex};
+        return _symbols.at(id);
+    }
+
+    std::size_t SymbolTable::size() const {
+        std::lock_guard<std::mutex> lock {_mutex};
+        return _symbols.size();
+    }
+
+    SymbolTable& SymbolTable::connectives() {
+        static SymbolTable table;
+        return table;
+    }
+
+    SymbolTable& SymbolTable::variables() {
+        static SymbolTable table;
+        return table;
+    }
+
+    const Formula::Metadata& Formula::metadata() const {
+        auto cached = std::atomic_load(&_metadata);
+        if (cached != nullptr)
+            return *cached;
+        auto computed = std::make_shared<Metadata>();
+        if (_type == FmlaType::PROP) {
+            utils::bitmask_set(computed->variables, static_cast<const Prop*>(this)->symbol_id());
+        } else {
+            auto compound = static_cast<const Compound*>(this);
+            utils::bitmask_set(computed->connectives, compound->connective()->symbol_id());
+            for (const auto& c : compound->components()) {
+                const auto& cm = c->metadata();
+                utils::bitmask_union(computed->variables, cm.variables);
+                utils::bitmask_union(computed->connectives, cm.connectives);
+                computed->depth = std::max(computed->depth, cm.depth);
+            }
+            computed->depth += 1;
+        }
+        // keep the first stored metadata, so that references given away stay valid
+        std::shared_ptr<const Metadata> expected = nullptr;
+        if (std::atomic_compare_exchange_strong(&_metadata, &expected, 
+                    std::shared_ptr<const Metadata>{computed}))
+            return *computed;
+        return *expected;
+    }
+
+    std::vector<std::shared_ptr<Formula>> Formula::subformulas() const {
+        std::vector<std::shared_ptr<Formula>> result;
+        if (_type != FmlaType::COMPOUND)
+            return result;
+        // iterative post-order walk, so that deep formulas do not
+        // exhaust the stack; each distinct subformula is expanded once
+        FmlaHashSet seen;
+        std::vector<std::pair<std::shared_ptr<Formula>, std::size_t>> stack;
+        const auto& top = static_cast<const Compound*>(this)->components();
+        for (auto it = top.rbegin(); it != top.rend(); ++it)
+            stack.push_back({*it, 0});
+        while (not stack.empty()) {
+            auto& [fmla, next] = stack.back();
+            if (next == 0 and seen.find(fmla) != seen.end()) {
+                stack.pop_back();
+                continue;
+            }
+            if (fmla->type() == FmlaType::COMPOUND) {
+                const auto& comps = std::static_pointer_cast<Compound>(fmla)->components();
+                if (next < comps.size()) {
+                    auto child = comps[next++];
+                    stack.push_back({child, 0});
+                    continue;
+                }
+            }
+            if (seen.insert(fmla).second)
+                result.push_back(fmla);
+            stack.pop_back();
+        }
+        return result;
+    }
+
     bool Formula::operator<(const Formula& p1) const {
+        if (this == &p1 or (shares_factory_with(p1) and _id == p1._id))
+            return false;
         StrictWeakOrderingFormulaVisitor orderTester (this);
         return p1.accept(orderTester);
     }
 
     bool Formula::operator==(const Formula& p1) const {
+        if (this == &p1)
+            return true;
+        if (shares_factory_with(p1))
+            return _id == p1._id;
+        if (_hash != p1._hash)
+            return false;
         EqualityFormulaVisitor equalityTester (this);
         return p1.accept(equalityTester);
     }
@@ -45,4 +139,208 @@ namespace ltsy {
                 utils::DeepSharedPointerComp<Formula>());
         return inters;
     }
+
+    bool is_subset(const FmlaHashSet& f1, const FmlaHashSet& f2) {
+        return utils::is_subset(f1, f2);
+    }
+
+    bool is_subset(const FmlaSet& f1, const FmlaHashSet& f2) {
+        if (f1.size() > f2.size()) return false;
+        for (auto& e : f1) 
+            if (f2.find(e) == f2.end()) 
+                return false;
+        return true;
+    }
+
+    FmlaHashSet intersection(const FmlaHashSet& s1, const FmlaHashSet& s2) {
+        // probe the larger set with the elements of the smaller
+        const auto& smaller = s1.size() <= s2.size() ? s1 : s2;
+        const auto& larger = s1.size() <= s2.size() ? s2 : s1;
+        FmlaHashSet inters;
+        for (const auto& e : smaller)
+            if (larger.find(e) != larger.end())
+                inters.insert(e);
+        return inters;
+    }
+
+    FmlaSet intersection(const FmlaSet& s1, const FmlaHashSet& s2) {
+        FmlaSet inters;
+        for (const auto& e : s1)
+            if (s2.find(e) != s2.end())
+                inters.insert(inters.end(), e);
+        return inters;
+    }
+
+    FmlaHashSet difference(const FmlaHashSet& s1, const FmlaHashSet& s2) {
+        FmlaHashSet diff;
+        for (const auto& e : s1)
+            if (s2.find(e) == s2.end())
+                diff.insert(e);
+        return diff;
+    }
+
+    FmlaSet difference(const FmlaSet& s1, const FmlaHashSet& s2) {
+        FmlaSet diff;
+        for (const auto& e : s1)
+            if (s2.find(e) == s2.end())
+                diff.insert(diff.end(), e);
+        return diff;
+    }
+
+    std::atomic<std::size_t> FormulaFactory::_next_serial {1};
+
+    std::size_t FormulaFactory::CompoundKeyHash::operator()(const CompoundKey& key) const {
+        std::size_t seed = key.symbol;
+        utils::hash_combine(seed, key.arity);
+        for (auto c : key.components)
+            utils::hash_combine(seed, c);
+        return seed;
+    }
+
+    std::shared_ptr<Prop> FormulaFactory::make_prop(const Symbol& symbol) {
+        auto it = _props.find(SymbolTable::variables().id(symbol));
+        if (it != _props.end())
+            return it->second;
+        auto prop = std::make_shared<Prop>(symbol);
+        register_node(*prop);
+        _props.insert({prop->symbol_id(), prop});
+        return prop;
+    }
+
+    std::shared_ptr<Formula> FormulaFactory::make_compound(std::shared_ptr<Connective> connective,
+            const std::vector<std::shared_ptr<Formula>>& components) {
+        CompoundKey key {connective->symbol_id(), connective->arity(), {}};
+        std::vector<std::shared_ptr<Formula>> interned_components;
+        key.components.reserve(components.size());
+        interned_components.reserve(components.size());
+        for (const auto& c : components) {
+            if (c == nullptr)
+                throw std::invalid_argument(NULL_POINTER_TO_COMPOUND);
+            auto ic = intern(c);
+            key.components.push_back(ic->_id);
+            interned_components.push_back(ic);
+        }
+        auto it = _compounds.find(key);
+        if (it != _compounds.end())
+            return it->second;
+        auto compound = std::make_shared<Compound>(connective, interned_components);
+        register_node(*compound);
+        _compounds.insert({std::move(key), compound});
+        return compound;
+    }
+
+    std::shared_ptr<Formula> FormulaFactory::intern(std::shared_ptr<Formula> fmla) {
+        if (fmla == nullptr or owns(*fmla))
+            return fmla;
+        if (fmla->type() == Formula::FmlaType::PROP)
+            return make_prop(std::static_pointer_cast<Prop>(fmla)->symbol());
+        auto compound = std::static_pointer_cast<Compound>(fmla);
+        return make_compound(compound->connective(), compound->components());
+    }
+
+    std::shared_ptr<Formula> FormulaFactory::find(const std::shared_ptr<Formula>& fmla) const {
+        if (fmla == nullptr or owns(*fmla))
+            return fmla;
+        if (fmla->type() == Formula::FmlaType::PROP) {
+            auto it = _props.find(std::static_pointer_cast<Prop>(fmla)->symbol_id());
+            return it == _props.end() ? nullptr : it->second;
+        }
+        auto compound = std::static_pointer_cast<Compound>(fmla);
+        std::vector<std::size_t> component_ids;
+        component_ids.reserve(compound->components().size());
+        for (const auto& c : compound->components()) {
+            auto node = find(c);
+            if (node == nullptr)
+                return nullptr;
+            component_ids.push_back(node->_id);
+        }
+        auto connective = compound->connective();
+        return find_compound(connective->symbol_id(), connective->arity(), component_ids);
+    }
+
+    std::shared_ptr<Formula> FormulaFactory::find_compound(SymbolId symbol, Arity arity, 
+            const std::vector<std::size_t>& component_ids) const {
+        auto it = _compounds.find(CompoundKey {symbol, arity, component_ids});
+        return it == _compounds.end() ? nullptr : it->second;
+    }
+
+    FmlaSet FormulaFactory::intern(const FmlaSet& fmlas) {
+        FmlaSet result;
+        for (const auto& f : fmlas)
+            result.insert(result.end(), intern(f));
+        return result;
+    }
+
+    std::size_t FormulaPool::NodeKeyHash::operator()(const std::vector<std::size_t>& key) const {
+        std::size_t seed = key.size();
+        for (auto k : key)
+            utils::hash_combine(seed, k);
+        return seed;
+    }
+
+    std::size_t FormulaPool::add_node(Formula::FmlaType type, std::size_t symbol, 
+            const std::vector<std::size_t>& children) {
+        std::vector<std::size_t> key {static_cast<std::size_t>(type), symbol};
+        key.insert(key.end(), children.begin(), children.end());
+        auto it = _node_ids.find(key);
+        if (it != _node_ids.end())
+            return it->second;
+        auto index = _nodes.size();
+        _nodes.push_back(Node{type, symbol, _children.size(), children.size()});
+        _children.insert(_children.end(), children.begin(), children.end());
+        _node_ids.insert({std::move(key), index});
+        return index;
+    }
+
+    std::size_t FormulaPool::add(const std::shared_ptr<Formula>& fmla) {
+        if (fmla == nullptr)
+            throw std::invalid_argument(NULL_POINTER_TO_COMPOUND);
+        if (fmla->type() == Formula::FmlaType::PROP) {
+            auto prop = std::static_pointer_cast<Prop>(fmla);
+            auto [it, inserted] = _variable_ids.insert({prop->symbol_id(), _variables.size()});
+            if (inserted)
+                _variables.push_back(Prop{prop->symbol()});
+            return add_node(Formula::FmlaType::PROP, it->second, {});
+        }
+        auto compound = std::static_pointer_cast<Compound>(fmla);
+        auto connective = compound->connective();
+        auto [it, inserted] = _connective_ids.insert({connective->symbol_id(), _connectives.size()});
+        if (inserted)
+            _connectives.push_back(connective);
+        auto symbol = it->second;
+        std::vector<std::size_t> children;
+        children.reserve(compound->components().size());
+        for (const auto& c : compound->components())
+            children.push_back(add(c));
+        return add_node(Formula::FmlaType::COMPOUND, symbol, children);
+    }
+
+    std::shared_ptr<Formula> FormulaPool::formula(std::size_t node) const {
+        if (node >= _nodes.size())
+            throw std::out_of_range("node not in the formula pool");
+        // nodes are in post-order: mark the subformulas top-down,
+        // then build them bottom-up
+        std::vector<bool> needed (node + 1, false);
+        needed[node] = true;
+        for (std::size_t i = node + 1; i-- > 0;)
+            if (needed[i])
+                for (std::size_t k = 0; k < _nodes[i].arity; ++k)
+                    needed[child(i, k)] = true;
+        std::vector<std::shared_ptr<Formula>> built (node + 1);
+        for (std::size_t i = 0; i <= node; ++i) {
+            if (not needed[i])
+                continue;
+            const auto& n = _nodes[i];
+            if (n.type == Formula::FmlaType::PROP) {
+                built[i] = std::make_shared<Prop>(_variables[n.symbol]);
+            } else {
+                std::vector<std::shared_ptr<Formula>> components;
+                components.reserve(n.arity);
+                for (std::size_t k = 0; k < n.arity; ++k)
+                    components.push_back(built[child(i, k)]);
+                built[i] = std::make_shared<Compound>(_connectives[n.symbol], components);
+            }
+        }
+        return built[node];
+    }
 }
@@ -9,30 +9,23 @@ namespace ltsy::utils {
     std::vector<int> tuple_from_position(int nvalues, int arity, int position) {
         if (position < 0 or position > int(std::pow(nvalues, arity)))
             throw std::invalid_argument(ltsy::WRONG_TUPLE_POSITION_EXCEPTION);
-        auto i = arity - 1;
-        std::vector<int> tuple (arity, 0);
-        while (i >= 0) {
-            auto power = int(std::pow(nvalues, i));
-            tuple[arity - i - 1] = position / power;
-            position %= power;
-            i -= 1;
-        }
-        return tuple;
+        return RowCursor {nvalues, arity, position}.tuple();
     }
 
     int position_from_tuple(int nvalues, int arity, const std::vector<int>& tuple) {
-        int i = 0;
         int position = 0;
-        while (i < arity) {
-            auto power = int(std::pow(nvalues, arity - i - 1));
-            position += tuple[i] * power;
-            ++i;
-        }
+        for (int i = 0; i < arity; ++i)
+            position = position * nvalues + tuple[i];
         return position;
     }
 
-    int compute_number_of_functions(int nvalues, int arity) {
-        return std::pow(nvalues, compute_number_of_rows(nvalues, arity)); 
+    std::uint64_t compute_number_of_functions(int nvalues, int arity) {
+        std::uint64_t quantity = 1;
+        auto rows = compute_number_of_rows(nvalues, arity);
+        for (int i = 0; i < rows; ++i)
+            if (__builtin_mul_overflow(quantity, std::uint64_t(nvalues), &quantity))
+                throw std::overflow_error(ltsy::TOO_MANY_FUNCTIONS_EXCEPTION);
+        return quantity;
     }
 
     int compute_number_of_rows(int nvalues, int arity) { 
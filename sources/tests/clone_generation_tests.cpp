@@ -6,6 +6,21 @@
 
 namespace {
 
+    TEST(CloneGen, UnaryCloneOfNegation) {
+        ltsy::BisonFmlaParser parser;
+        auto tt_neg = ltsy::TruthTable<std::set<int>>(3, 
+                {
+                    {{0},{2}},
+                    {{1},{0}},
+                    {{2},{0}},
+        }, parser.parse("neg p"));
+        ltsy::CloneGenerator generator {3, {tt_neg}};
+        auto clone = generator.generate(1, {parser.parse("p")});
+        // p, neg p and neg neg p
+        ASSERT_EQ(clone.size(), 3);
+        ASSERT_TRUE(clone.find(tt_neg) != clone.end());
+    }
+
     TEST(CloneGen, GenerateCloneGodel) {
         ltsy::BisonFmlaParser parser;
         auto p = parser.parse("p");
@@ -21,6 +21,26 @@ namespace {
         ASSERT_EQ(r, a);
     }
 
+    TEST(CoreUtils, RowCursor) {
+        int rows = 0;
+        for (ltsy::utils::RowCursor row {4, 3}; not row.done(); row.next(), ++rows) {
+            ASSERT_EQ(row.position(), rows);
+            ASSERT_EQ(row.tuple(), ltsy::utils::tuple_from_position(4, 3, rows));
+            ASSERT_EQ(ltsy::utils::position_from_tuple(4, 3, row.tuple()), rows);
+        }
+        ASSERT_EQ(rows, 64);
+        ltsy::utils::RowCursor nullary {3, 0};
+        ASSERT_FALSE(nullary.done());
+        ASSERT_FALSE(nullary.next());
+        ASSERT_TRUE(nullary.done());
+        ltsy::utils::RowCursor cursor {3, 2, 5};
+        ASSERT_EQ(cursor[0], 1); ASSERT_EQ(cursor[1], 2);
+        cursor.seek(9);
+        ASSERT_TRUE(cursor.done());
+        cursor.reset();
+        ASSERT_EQ(cursor.tuple(), (std::vector<int>{0, 0}));
+    }
+
     TEST(CoreUtils, TupleAndPosition) {
         {
             {
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "core/semantics/genmatrix.h"
+#include "core/parser/fmla/fmla_parser.h"
+#include "apps/apps_facade.h"
 
 namespace {
 
@@ -180,6 +182,324 @@ namespace {
        //ltsy::NdSequent<std::set> seq6 ({{p_conn_q}, {}, {q}, {}});
     }
 
+    std::shared_ptr<ltsy::Signature> neg_and_sig = 
+        std::make_shared<ltsy::Signature>(ltsy::Signature {{"neg", 1}, {"and", 2}});
+
+    /* Matrix over neg and and, with the designated values and
+     * their complement as distinguished sets.
+     * */
+    std::shared_ptr<ltsy::GenMatrix> make_neg_and_matrix(int nvalues, std::vector<std::set<int>> neg, 
+            std::vector<std::set<int>> conj, std::set<int> designated) {
+        auto sig = neg_and_sig;
+        auto interp = std::make_shared<ltsy::SignatureTruthInterp<std::set<int>>>(sig);
+        interp->try_interpret(std::make_shared<ltsy::TruthInterp<std::set<int>>>((*sig)["neg"],
+                std::make_shared<ltsy::NDTruthTable>(nvalues, 1, neg)));
+        interp->try_interpret(std::make_shared<ltsy::TruthInterp<std::set<int>>>((*sig)["and"],
+                std::make_shared<ltsy::NDTruthTable>(nvalues, 2, conj)));
+        std::set<int> values, undesignated;
+        for (int v = 0; v < nvalues; ++v) {
+            values.insert(v);
+            if (designated.count(v) == 0)
+                undesignated.insert(v);
+        }
+        return std::make_shared<ltsy::GenMatrix>(values, 
+                std::vector<std::set<int>>{designated, undesignated}, sig, interp);
+    }
+
+    /* Three-valued matrix over neg and and, with 2 designated,
+     * whose and is both partial and non-deterministic.
+     * */
+    std::shared_ptr<ltsy::GenMatrix> make_partial_matrix() {
+        return make_neg_and_matrix(3, {{2}, {0,1}, {0}}, 
+                {{0}, {0}, {0,1}, {0}, {1,2}, {1}, {}, {1,2}, {0,2}}, {2});
+    }
+
+    ltsy::NdSequent<std::set> make_sequent(std::vector<std::string> left, std::vector<std::string> right) {
+        ltsy::BisonFmlaParser parser;
+        std::set<std::shared_ptr<ltsy::Formula>, ltsy::utils::DeepSharedPointerComp<ltsy::Formula>> l, r;
+        for (const auto& s : left) l.insert(parser.parse(s));
+        for (const auto& s : right) r.insert(parser.parse(s));
+        return ltsy::NdSequent<std::set>({l, r});
+    }
+
+    TEST(GenMatrices, NdSequentSoundnessSearch) {
+        auto sig = neg_and_sig;
+        auto make_matrix = make_neg_and_matrix;
+        auto seq = make_sequent;
+        // partial and non-deterministic matrix: searching agrees with enumerating
+        auto matrix = make_partial_matrix();
+        ltsy::NdSequentGenMatrixValidator<std::set> validator {matrix, {0,1}};
+        std::vector<ltsy::NdSequentRule<std::set>> rules {
+            {{seq({}, {"p and q"})}, {seq({}, {"p"})}},
+            {{seq({}, {"p and q"})}, {seq({}, {"q"})}},
+            {{seq({}, {"p"}), seq({}, {"q"})}, {seq({}, {"p and q"})}},
+            {{seq({}, {"p"})}, {seq({}, {"neg neg p"})}},
+            {{seq({"p"}, {})}, {seq({}, {"neg p"})}},
+            {{seq({}, {"neg (p and q)"})}, {seq({}, {"neg p", "neg q"})}},
+            {{seq({}, {"p and (q and r)"})}, {seq({}, {"(p and q) and r"})}},
+            {{}, {seq({}, {"p", "neg p"})}},
+            {{seq({"p and q"}, {})}, {seq({"p"}, {}), seq({}, {"q"})}},
+        };
+        for (const auto& rule : rules) {
+            auto enumerated = validator.is_rule_satisfiability_preserving(rule);
+            auto searched = validator.search_counter_examples(rule, *sig, 3);
+            ASSERT_EQ(enumerated.has_value(), searched.has_value());
+            if (searched) {
+                for (const auto& ce : *searched) {
+                    for (const auto& p : rule.premises())
+                        ASSERT_TRUE(validator.is_valid_under_valuation(ce.val, p));
+                    for (const auto& c : rule.conclusions())
+                        ASSERT_FALSE(validator.is_valid_under_valuation(ce.val, c));
+                }
+            }
+        }
+        // many determinizations, few of them reachable by the rules
+        std::vector<std::set<int>> conj;
+        for (int a = 0; a < 4; ++a)
+            for (int b = 0; b < 4; ++b)
+                conj.push_back({std::min(a, b), std::min(a, b) ^ 1});
+        auto big_matrix = make_matrix(4, {{3}, {2}, {1}, {0}}, conj, {2,3});
+        ltsy::NdSequentGenMatrixValidator<std::set> big_validator {big_matrix, {0,1}};
+        ltsy::NdSequentRule<std::set> sound {{seq({}, {"p and (q and r)"})}, {seq({}, {"r"})}};
+        ltsy::NdSequentRule<std::set> unsound {{seq({}, {"p and q"}), seq({}, {"r"})}, {seq({}, {"neg (p and r)"})}};
+        ASSERT_FALSE(big_validator.is_rule_satisfiability_preserving(sound).has_value());
+        auto ce = big_validator.is_rule_satisfiability_preserving(unsound);
+        ASSERT_TRUE(ce.has_value());
+        ASSERT_TRUE(big_validator.is_valid_under_valuation((*ce)[0].val, unsound.premises()[0]));
+        ASSERT_FALSE(big_validator.is_valid_under_valuation((*ce)[0].val, unsound.conclusions()[0]));
+        // too many variable assignments to enumerate them
+        std::string conjunction = "p11";
+        for (int i = 10; i >= 2; --i)
+            conjunction = "p" + std::to_string(i) + " and (" + conjunction + ")";
+        ltsy::NdSequentRule<std::set> contradictory {{seq({}, {"p1"}), seq({}, {"neg p1"}), 
+            seq({}, {conjunction})}, {seq({}, {"p2"})}};
+        ASSERT_FALSE(big_validator.is_rule_satisfiability_preserving(contradictory).has_value());
+    }
+
+    TEST(GenMatrices, NdSequentSoundnessParallel) {
+        auto matrix = make_partial_matrix();
+        auto seq = make_sequent;
+        ltsy::NdSequentGenMatrixValidator<std::set> validator {matrix, {0,1}};
+        // the ranges cover the valuations of the generator
+        ltsy::NdSequentRule<std::set> rule {{seq({}, {"neg (p and q)"})}, {seq({}, {"neg p", "neg q"})}};
+        auto props_set = rule.collect_props();
+        std::vector<std::shared_ptr<ltsy::Prop>> props {props_set.begin(), props_set.end()};
+        ltsy::GenMatrixValuationGenerator generator {matrix, props, neg_and_sig};
+        ltsy::GenMatrixValuationRange all {matrix, props, neg_and_sig};
+        ASSERT_EQ(all.total(), generator.total());
+        ltsy::GenMatrixValuationRange tail {matrix, props, neg_and_sig, all.total() - 2};
+        ASSERT_TRUE(tail.has_next());
+        tail.next();
+        tail.next();
+        ASSERT_FALSE(tail.has_next());
+        // same answers as with a single thread, sharing the budget of counter-examples
+        std::vector<ltsy::NdSequentRule<std::set>> rules {
+            rule,
+            {{seq({}, {"p and q"})}, {seq({}, {"q"})}},
+            {{seq({}, {"p"})}, {seq({}, {"neg neg p"})}},
+            {{seq({}, {"p and (q and r)"})}, {seq({}, {"(p and q) and r"})}},
+        };
+        for (const auto& r : rules) {
+            auto single = validator.is_rule_satisfiability_preserving(r, *neg_and_sig, 2);
+            auto parallel = validator.is_rule_satisfiability_preserving(r, *neg_and_sig, 2, std::nullopt, 4);
+            ASSERT_EQ(single.has_value(), parallel.has_value());
+            if (parallel) {
+                ASSERT_EQ(parallel->size(), single->size());
+                for (const auto& ce : *parallel) {
+                    ASSERT_TRUE(validator.is_valid_under_valuation(ce.val, r.premises()[0]));
+                    ASSERT_FALSE(validator.is_valid_under_valuation(ce.val, r.conclusions()[0]));
+                }
+            }
+        }
+        // rules checked concurrently by the facade, a failing rule not affecting the others
+        std::vector<ltsy::NdSequentRule<std::set>> named;
+        for (std::size_t i = 0; i < rules.size(); ++i)
+            named.push_back({"r" + std::to_string(i), rules[i].premises(), rules[i].conclusions()});
+        named.push_back({"bad", {seq({}, {"p or q"})}, {seq({}, {"p"})}});
+        ltsy::AppsFacade facade;
+        std::map<std::string, std::exception_ptr> failures;
+        auto concurrent = facade.sequent_rule_soundness_check_gen_matrix(matrix, {0,1}, named, 1, 
+                std::nullopt, 4, &failures);
+        ASSERT_EQ(failures.size(), 1);
+        ASSERT_TRUE(failures.count("bad"));
+        ASSERT_EQ(concurrent.size(), rules.size());
+        for (std::size_t i = 0; i < rules.size(); ++i)
+            ASSERT_EQ(concurrent["r" + std::to_string(i)].has_value(), 
+                    validator.is_rule_satisfiability_preserving(rules[i]).has_value());
+        ASSERT_ANY_THROW(facade.sequent_rule_soundness_check_gen_matrix(matrix, {0,1}, named, 1, 
+                    std::nullopt, 4));
+    }
+
+    TEST(GenMatrices, NdSequentSoundnessSampling) {
+        auto matrix = make_partial_matrix();
+        auto seq = make_sequent;
+        ltsy::NdSequentGenMatrixValidator<std::set> validator {matrix, {0,1}};
+        // unsound rule: refuted, reproducibly for a given seed
+        ltsy::NdSequentRule<std::set> unsound {{seq({}, {"p and q"})}, {seq({}, {"q"})}};
+        auto sampled = validator.sample_counter_examples(unsound, *neg_and_sig, 1000, 42, 2);
+        ASSERT_EQ(sampled.counter_examples.size(), 2);
+        ASSERT_LE(sampled.samples, 1000);
+        ASSERT_FALSE(sampled.max_counter_example_rate.has_value());
+        for (const auto& ce : sampled.counter_examples)
+            ASSERT_TRUE(validator.is_counter_example(ce.val, unsound));
+        auto again = validator.sample_counter_examples(unsound, *neg_and_sig, 1000, 42, 2);
+        ASSERT_EQ(again.samples, sampled.samples);
+        // the draws depend only on the output of the generator, the same everywhere
+        ASSERT_EQ(sampled.samples, 11);
+        // sound rule: never refuted, with a bound on the rate of counter-examples
+        ltsy::NdSequentRule<std::set> sound {{seq({}, {"p"})}, {seq({}, {"neg neg p"})}};
+        ASSERT_FALSE(validator.is_rule_satisfiability_preserving(sound).has_value());
+        auto bounded = validator.sample_counter_examples(sound, *neg_and_sig, 300, 7, 1, 0.95);
+        ASSERT_TRUE(bounded.counter_examples.empty());
+        ASSERT_EQ(bounded.samples, 300);
+        ASSERT_NEAR(*bounded.max_counter_example_rate, 3.0 / 300, 1e-3);
+        ASSERT_THROW(validator.sample_counter_examples(sound, *neg_and_sig, 10, 0, 1, 1.0), std::invalid_argument);
+    }
+
+    TEST(GenMatrices, CounterExampleCache) {
+        auto matrix = make_partial_matrix();
+        auto seq = make_sequent;
+        ltsy::NdSequentRule<std::set> unsound {{seq({}, {"p and q"})}, {seq({}, {"q"})}};
+        ltsy::NdSequentRule<std::set> renamed {{seq({}, {"r and s"})}, {seq({}, {"s"})}};
+        ltsy::NdSequentRule<std::set> sound {{seq({}, {"p"})}, {seq({}, {"neg neg p"})}};
+        {
+            ltsy::NdSequentGenMatrixValidator<std::set> validator {matrix, {0,1}};
+            ltsy::GenMatrixCounterExampleCache cache;
+            ASSERT_TRUE(validator.is_rule_satisfiability_preserving(unsound, *neg_and_sig, 1, 
+                        std::nullopt, 1, &cache).has_value());
+            ASSERT_EQ(cache.size(), 1);
+            // the same refutation, up to the names of the variables, comes from the cache
+            auto props_set = renamed.collect_props();
+            std::vector<std::shared_ptr<ltsy::Prop>> props {props_set.begin(), props_set.end()};
+            ASSERT_EQ(cache.candidates(matrix, props, neg_and_sig).size(), 1);
+            auto ce = validator.is_rule_satisfiability_preserving(renamed, *neg_and_sig, 1, std::nullopt, 1, &cache);
+            ASSERT_TRUE(ce.has_value());
+            ASSERT_TRUE(validator.is_counter_example((*ce)[0].val, renamed));
+            ASSERT_EQ(cache.size(), 1);
+            // other numbers of variables and sound rules are checked as before
+            ASSERT_FALSE(validator.is_rule_satisfiability_preserving(sound, *neg_and_sig, 1, 
+                        std::nullopt, 1, &cache).has_value());
+            ASSERT_EQ(cache.size(), 1);
+        }
+        // the facade keeps a cache for each matrix
+        ltsy::AppsFacade facade;
+        facade.sequent_rule_soundness_check_gen_matrix(matrix, {0,1}, 
+                {{"unsound", unsound.premises(), unsound.conclusions()}});
+        ASSERT_EQ(facade.counter_example_cache(matrix)->size(), 1);
+        auto results = facade.sequent_rule_soundness_check_gen_matrix(matrix, {0,1}, 
+                {{"renamed", renamed.premises(), renamed.conclusions()}, 
+                 {"sound", sound.premises(), sound.conclusions()}});
+        ASSERT_TRUE(results["renamed"].has_value());
+        ASSERT_FALSE(results["sound"].has_value());
+        ASSERT_EQ(facade.counter_example_cache(matrix)->size(), 1);
+        // without pinning the matrices
+        std::weak_ptr<ltsy::GenMatrix> released = matrix;
+        results.clear();
+        matrix.reset();
+        ASSERT_TRUE(released.expired());
+        ASSERT_EQ(facade.counter_example_caches(), 0);
+    }
+
+    TEST(GenMatrices, GrayOrderIncrementalEvaluation) {
+        auto matrix = make_partial_matrix();
+        ltsy::BisonFmlaParser parser;
+        ltsy::FormulaPool pool {{parser.parse("neg (p and q)"), parser.parse("neg p and (p and q)"), 
+            parser.parse("(p and neg q) and neg neg q")}};
+        std::vector<std::shared_ptr<ltsy::Prop>> props {std::make_shared<ltsy::Prop>("p"), 
+            std::make_shared<ltsy::Prop>("q")};
+        auto state = [](const ltsy::GenMatrixValuationRange& range) {
+            std::vector<std::set<int>> s {{range.value(0)}, {range.value(1)}};
+            for (const auto& t : range.tables())
+                for (int row = 0; row < t->number_of_rows(); ++row)
+                    s.push_back(t->image_at(row));
+            return s;
+        };
+        auto differences = [](const std::vector<std::set<int>>& a, const std::vector<std::set<int>>& b) {
+            int d = 0;
+            for (std::size_t i = 0; i < a.size(); ++i)
+                d += a[i] != b[i];
+            return d;
+        };
+        ltsy::GenMatrixValuationRange range {matrix, props, neg_and_sig};
+        ltsy::GenMatrixIncrementalEvaluator incremental {pool, range};
+        std::set<std::vector<std::set<int>>> visited;
+        std::vector<std::vector<std::set<int>>> states;
+        while (range.has_next()) {
+            auto val = range.next();
+            states.push_back(state(range));
+            visited.insert(states.back());
+            // consecutive valuations differ in a single variable or row
+            if (states.size() > 1)
+                ASSERT_EQ(differences(states[states.size() - 2], states.back()), 1);
+            ltsy::GenMatrixEvaluator evaluator {*val};
+            ASSERT_EQ(incremental.update(), evaluator.evaluate_masks(pool));
+        }
+        ASSERT_EQ(visited.size(), range.total());
+        // a sub-range gives the same valuations, also when stepping without building them
+        ltsy::GenMatrixValuationRange middle {matrix, props, neg_and_sig, 5, 9};
+        for (int i = 5; middle.has_next(); ++i) {
+            middle.step();
+            ASSERT_EQ(state(middle), states[i]);
+        }
+        ASSERT_EQ((*middle.valuation())(*props[0]), middle.value(0));
+    }
+
+    TEST(GenMatrices, RelevantValuations) {
+        auto matrix = make_partial_matrix();
+        ltsy::BisonFmlaParser parser;
+        ltsy::FormulaPool pool {{parser.parse("neg (p and q)"), parser.parse("neg p and (p and q)")}};
+        std::vector<std::shared_ptr<ltsy::Prop>> props {std::make_shared<ltsy::Prop>("p"), 
+            std::make_shared<ltsy::Prop>("q")};
+        // the values the formulas may take under each assignment
+        auto outcomes = [&](ltsy::GenMatrixValuationRange& range) {
+            std::set<std::pair<std::vector<int>, std::vector<ltsy::ValueMask>>> result;
+            ltsy::GenMatrixIncrementalEvaluator evaluator {pool, range};
+            while (range.has_next()) {
+                range.next();
+                auto values = evaluator.update();
+                result.insert({{range.value(0), range.value(1)}, {values.begin(), values.end()}});
+            }
+            return result;
+        };
+        ltsy::GenMatrixValuationRange all {matrix, props, neg_and_sig};
+        ltsy::GenMatrixValuationRange relevant {matrix, props, neg_and_sig, pool};
+        ASSERT_LT(relevant.total(), all.total());
+        auto relevant_outcomes = outcomes(relevant);
+        ASSERT_EQ(relevant_outcomes, outcomes(all));
+        // slices share the groups of the assignments
+        std::set<std::pair<std::vector<int>, std::vector<ltsy::ValueMask>>> sliced;
+        for (ltsy::GenMatrixValuationRange::Index b = 0; b < relevant.total(); b += 7) {
+            auto slice = relevant.slice(b, std::min(b + 7, relevant.total()));
+            auto part = outcomes(slice);
+            sliced.insert(part.begin(), part.end());
+        }
+        ASSERT_EQ(sliced, relevant_outcomes);
+    }
+
+    TEST(GenMatrices, MemoizedEvaluation) {
+        auto matrix = make_partial_matrix();
+        ltsy::BisonFmlaParser parser;
+        auto fmlas = std::vector<std::shared_ptr<ltsy::Formula>> {parser.parse("p and q"), 
+            parser.parse("neg (p and q)"), parser.parse("neg p and (p and q)"), parser.parse("q")};
+        ltsy::NdSequentGenMatrixValidator<std::set> validator {matrix, {0,1}};
+        ltsy::NdSequentRule<std::set> rule {{make_sequent({}, {"p and q"})}, 
+            {make_sequent({"neg p and (p and q)"}, {"neg (p and q)"})}};
+        ltsy::GenMatrixValuationRange range {matrix, {std::make_shared<ltsy::Prop>("p"), 
+            std::make_shared<ltsy::Prop>("q")}, neg_and_sig};
+        while (range.has_next()) {
+            auto val = range.next();
+            // a single context for all formulas, not copying the valuation
+            ltsy::GenMatrixEvaluator memo {*val};
+            for (const auto& f : fmlas) {
+                ltsy::GenMatrixEvaluator visitor {val};
+                ASSERT_EQ(memo.evaluate_mask(f).to_set(), f->accept(visitor));
+            }
+            ASSERT_EQ(validator.is_counter_example(*val, rule), 
+                    validator.is_valid_under_valuation(*val, rule.premises()[0])
+                    and not validator.is_valid_under_valuation(*val, rule.conclusions()[0]));
+        }
+    }
+
     TEST(GenMatrices, TTDeterminizationGenerator) {
         auto tt_or =  ltsy::TruthTable<std::set<int>>(2, 2, std::vector<std::set<int>>{{0, 1}, {0}, {}, {1,0}});
         ltsy::PartialDeterministicTruthTableGenerator generator {std::make_shared<ltsy::TruthTable<std::set<int>>>(tt_or)};
@@ -375,12 +695,18 @@ namespace {
        auto p_disj_q = std::make_shared<ltsy::Compound>(disj, std::vector<std::shared_ptr<ltsy::Formula>>{p, q});
 
        ltsy::GenMatrixValuationGenerator generator {cl_matrix, {p, q}};
+       ltsy::FormulaPool pool;
+       auto and_node = pool.add(p_conn_q);
+       auto or_node = pool.add(p_disj_q);
        int c = 0;
        while (generator.has_next()) {
            auto v = generator.next();
            ltsy::GenMatrixEvaluator evaluator {v};
            auto resand = p_conn_q->accept(evaluator);
            auto resor = p_disj_q->accept(evaluator);
+           auto values = evaluator.evaluate(pool);
+           ASSERT_EQ(values[and_node], resand);
+           ASSERT_EQ(values[or_node], resor);
            std::cout << resand << std::endl;
            std::cout << resor << std::endl;
            c++;
@@ -63,6 +63,61 @@ namespace {
         ltsy::Compound fmla ((*sig_ptr)["->"], std::vector<std::shared_ptr<ltsy::Formula>> {p, q});
 
         auto v = fmla.accept(evaluator);
+
+        // the flat evaluation agrees with the visitor
+        auto neg_fmla = std::make_shared<ltsy::Compound>((*sig_ptr)["~"], 
+                std::vector<std::shared_ptr<ltsy::Formula>> {std::make_shared<ltsy::Compound>(fmla)});
+        ltsy::FormulaPool pool;
+        auto i = pool.add(neg_fmla);
+        auto values = evaluator.evaluate(pool);
+        ASSERT_EQ(values[pool.child(i, 0)], v);
+        ASSERT_EQ(values[i], neg_fmla->accept(evaluator));
+
+
+        // interpretations and valuations indexed by symbol id
+        ASSERT_EQ(truth_interp.get_interpretation((*sig_ptr)["->"]->symbol_id()), imp_int);
+        ASSERT_EQ((*val)(q->symbol_id()), 1);
+    }
+
+    TEST(NMatrices, ColumnarEvaluation) {
+        auto sig_ptr = std::make_shared<ltsy::Signature>(ltsy::Signature {{"&", 2}, {"|", 2}, {"->", 2}, {"~", 1}});
+        auto interp = std::make_shared<ltsy::SignatureTruthInterp<int>>(sig_ptr);
+        auto interpret = [&](const std::string& symbol, int arity, std::vector<int> images) {
+            interp->try_interpret(std::make_shared<ltsy::TruthInterp<int>>((*sig_ptr)[symbol], 
+                        std::make_shared<ltsy::TruthTable<int>>(2, arity, images)));
+        };
+        interpret("&", 2, {0, 0, 0, 1});
+        interpret("|", 2, {0, 1, 1, 1});
+        interpret("->", 2, {1, 1, 0, 1});
+        interpret("~", 1, {1, 0});
+        auto cl_matrix = std::make_shared<ltsy::NMatrix>(2, std::set<int> {1}, sig_ptr, interp);
+        auto p = std::make_shared<ltsy::Prop>("p");
+        auto q = std::make_shared<ltsy::Prop>("q");
+        auto r = std::make_shared<ltsy::Prop>("r");
+        auto compound = [&](const std::string& symbol, std::vector<std::shared_ptr<ltsy::Formula>> components) {
+            return std::make_shared<ltsy::Compound>((*sig_ptr)[symbol], components);
+        };
+        // all the valuations of p, q, r at once, as the generator gives them
+        ltsy::NMatrixColumnarEvaluator columnar {cl_matrix, {*p, *q, *r}};
+        ASSERT_EQ(columnar.number_of_valuations(), 8);
+        auto imp = compound("->", {p, q});
+        auto big = compound("&", {compound("~", {imp}), r});
+        auto column = columnar.evaluate(big);
+        ltsy::NMatrixValuationGenerator generator {cl_matrix, {*p, *q, *r}};
+        for (std::size_t k = 0; generator.has_next(); ++k) {
+            ltsy::NMatrixEvaluator val_evaluator {std::make_shared<ltsy::NMatrixValuation>(generator.next())};
+            ASSERT_EQ(column[k], big->accept(val_evaluator));
+        }
+        ASSERT_TRUE(columnar.is_valid(compound("|", {p, compound("~", {p})})));
+        ASSERT_FALSE(columnar.is_valid(big));
+        // p -> q does not entail p
+        auto counterexample = columnar.counterexample({imp}, {p});
+        ASSERT_TRUE(counterexample);
+        ASSERT_EQ(columnar.valuation(*counterexample)(*p), 0);
+        // variables outside the evaluator are not assumed to be 0
+        auto s = std::make_shared<ltsy::Prop>("s");
+        ASSERT_THROW(columnar.evaluate(compound("&", {p, s})), std::invalid_argument);
+        ASSERT_THROW(columnar.counterexample({p}, {s}), std::invalid_argument);
     }
 
     TEST(NMatrices, NMatrixGenerator) {
@@ -84,6 +139,43 @@ namespace {
         std::cout << i << std::endl;
     }
 
+    TEST(NMatrices, GeneratorUpToIsomorphism) {
+        auto sig = std::make_shared<ltsy::Signature>(ltsy::Signature {{"~", 1}});
+        auto permutations = ltsy::value_permutations(3);
+        ASSERT_EQ(permutations.size(), 5);
+        // the orbits, by the canonical forms of all matrices
+        std::set<std::pair<std::vector<int>, std::set<int>>> orbits;
+        ltsy::NMatrixGenerator all {3, sig};
+        int total = 0;
+        while (all.has_next()) {
+            auto canonical = all.next()->canonical_form(permutations);
+            auto tt = canonical->interpretation()->get_interpretation("~")->truth_table();
+            std::vector<int> images;
+            for (int i = 0; i < tt->number_of_rows(); ++i)
+                images.push_back(tt->at(i));
+            orbits.insert({images, canonical->dvalues()});
+            ++total;
+        }
+        ASSERT_EQ(total, 27 * 8);
+        ltsy::NMatrixGenerator reduced {3, sig, true};
+        int count = 0;
+        for (; reduced.has_next(); ++count)
+            ASSERT_TRUE(reduced.next()->is_canonical(permutations));
+        ASSERT_EQ(count, orbits.size());
+        // unary functions up to the swap of 0 and 1
+        ltsy::SignatureTruthInterpGenerator interps {3, sig, true, std::set<int>{2}};
+        count = 1;
+        for (; interps.has_next(); ++count)
+            interps.next();
+        ASSERT_EQ(count, 15);
+        ltsy::TruthTable<int> neg {3, 1, std::vector<int>{2, 2, 0}};
+        auto canonical = ltsy::canonical_form(neg, permutations);
+        // a 2-cycle and a value mapped into it
+        ASSERT_EQ(canonical.at(0), 1);
+        ASSERT_EQ(canonical.at(1), 0);
+        ASSERT_EQ(canonical.at(2), 0);
+    }
+
     TEST(NMatrices, ValGenerator) {
         ltsy::Signature cl_sig {
             {"&", 2},
@@ -169,6 +261,39 @@ namespace {
         }
     };
 
+    TEST(NMatrices, LiftedImage) {
+        auto table = std::make_shared<ltsy::NDTruthTable>(3, 2, std::vector<std::set<int>>{
+                {0}, {1}, {0,2}, {}, {1,2}, {2}, {0,1,2}, {1}, {0}});
+        ltsy::TruthInterp<std::set<int>> interp {std::make_shared<ltsy::Connective>("and", 2), table};
+        auto check = [&]() {
+            for (std::uint64_t a = 0; a < 8; ++a)
+                for (std::uint64_t b = 0; b < 8; ++b) {
+                    std::vector<ltsy::ValueMask> args {ltsy::ValueMask {a}, ltsy::ValueMask {b}};
+                    ASSERT_EQ(interp.image(args), table->image(args));
+                }
+        };
+        check();
+        // the lifted table follows changes of the table
+        table->set(3, {0,1});
+        check();
+        ASSERT_EQ(interp.image({ltsy::ValueMask {0b11}, ltsy::ValueMask {0b01}}), ltsy::ValueMask {0b011});
+        // and assignments of the table, even from a table with the same number of changes
+        ltsy::NDTruthTable other {3, 2, std::vector<std::set<int>>{{2}, {2}, {2}, {2}, {2}, {2}, {2}, {2}, {2}}};
+        other.set(0, {1});
+        *table = other;
+        check();
+        // too many values to lift the table: images computed from the table
+        std::vector<std::set<int>> images;
+        for (int a = 0; a < 32; ++a)
+            for (int b = 0; b < 32; ++b)
+                images.push_back({std::min(a, b)});
+        auto big_table = std::make_shared<ltsy::NDTruthTable>(32, 2, images);
+        ltsy::TruthInterp<std::set<int>> big_interp {std::make_shared<ltsy::Connective>("and", 2), big_table};
+        std::vector<ltsy::ValueMask> args {ltsy::ValueMask {std::set<int>{5, 31}}, ltsy::ValueMask {std::set<int>{7, 30}}};
+        ASSERT_EQ(big_interp.image(args), ltsy::ValueMask (std::set<int>{5, 7, 30}));
+        ASSERT_EQ(big_interp.image(args), big_table->image(args));
+    };
+
     TEST(NMatrices, SigTruthInterpGenerator) {
         ltsy::Signature cl_sig {
             {"->", 2},
@@ -4,6 +4,27 @@
 
 namespace {
 
+    TEST(PNMAxiomatization, RemoveRenamingsReusesCanonicalForms) {
+        ltsy::BisonFmlaParser parser;
+        auto rule = [&](const std::string& name, const std::string& left, const std::string& right) {
+            ltsy::FmlaSet l {parser.parse(left)}, r {parser.parse(right)};
+            return ltsy::MultipleConclusionRule {name, ltsy::NdSequent<std::set>({l, r}), {{0,1}}};
+        };
+        ltsy::PNMMultipleConclusionAxiomatizer axiomatizer {{0,1}, {{0,1}}};
+        auto p_q = rule("p_q", "p", "q");
+        auto p_p = rule("p_p", "p", "p");
+        std::set<ltsy::MultipleConclusionRule> rules {p_q, rule("r_s", "r", "s"), p_p};
+        std::map<ltsy::MultipleConclusionRule, ltsy::NdSequent<std::set>> canonicals;
+        axiomatizer.remove_renamings(rules, &canonicals);
+        ASSERT_EQ(rules.size(), 2);
+        ASSERT_EQ(canonicals.size(), 3);
+        // the canonical forms already known are taken as given
+        canonicals.at(p_q) = canonicals.at(p_p);
+        std::set<ltsy::MultipleConclusionRule> again {p_q, p_p};
+        axiomatizer.remove_renamings(again, &canonicals);
+        ASSERT_EQ(again.size(), 1);
+    }
+
     TEST(PNMAxiomatization, Axiomatize2DExistsCheck) {
         ltsy::Signature cl_sig {
             {"&", 2},
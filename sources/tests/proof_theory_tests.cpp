@@ -47,6 +47,43 @@ namespace {
         }
     }
 
+    TEST(ProofTheory, NdSequentHashSet) {
+        ltsy::BisonFmlaParser parser;
+        ltsy::NdSequent<ltsy::utils::DeepHashSet> seq {{{parser.parse("p"), parser.parse("p -> q")}, 
+            {parser.parse("q")}}};
+        ltsy::NdSequent<ltsy::utils::DeepHashSet> other {{{parser.parse("p -> q"), parser.parse("p")}, 
+            {parser.parse("q")}}};
+        ASSERT_EQ(seq.dimension(), 2);
+        ASSERT_TRUE(seq == other);
+        ASSERT_EQ(seq.collect_props().size(), 2);
+        ASSERT_TRUE(seq.at(0).find(parser.parse("p -> q")) != seq.at(0).end());
+    }
+
+    TEST(ProofTheory, NdSequentCanonicalForm) {
+        ltsy::BisonFmlaParser parser;
+        ltsy::NdSequent<std::set> seq {{{parser.parse("q"), parser.parse("q -> r")}, 
+            {parser.parse("r"), parser.parse("neg p")}}};
+        ltsy::NdSequent<std::set> renamed {{{parser.parse("r"), parser.parse("r -> p")}, 
+            {parser.parse("p"), parser.parse("neg q")}}};
+        ltsy::NdSequent<std::set> other {{{parser.parse("r"), parser.parse("q -> r")}, 
+            {parser.parse("q"), parser.parse("neg p")}}};
+        ASSERT_TRUE(seq.canonical() == renamed.canonical());
+        ASSERT_EQ(seq.canonical_hash(), renamed.canonical_hash());
+        ASSERT_TRUE(seq.is_renaming_of(renamed));
+        ASSERT_FALSE(seq.is_renaming_of(other));
+        ASSERT_TRUE(seq.canonical().canonical() == seq.canonical());
+        // variables occurring alike are told apart by trying their renamings
+        ltsy::NdSequent<std::set> sym {{{parser.parse("p"), parser.parse("q")}, 
+            {parser.parse("p or q"), parser.parse("q or p")}}};
+        ltsy::NdSequent<std::set> sym_renamed {{{parser.parse("s"), parser.parse("r")}, 
+            {parser.parse("s or r"), parser.parse("r or s")}}};
+        ASSERT_TRUE(sym.canonical() == sym_renamed.canonical());
+        ltsy::MultipleConclusionRule rule {"r", seq, {{0,1}}};
+        ltsy::MultipleConclusionRule rule_renamed {"s", renamed, {{0,1}}};
+        ASSERT_TRUE(rule.is_renaming_of(rule_renamed));
+        ASSERT_EQ(rule.canonical().name(), "r");
+    }
+
     TEST(ProofTheory, MultipleConclusionRulesCreation) {
         auto p = std::make_shared<ltsy::Prop>("p");
         auto q = std::make_shared<ltsy::Prop>("q");
@@ -173,6 +210,36 @@ namespace {
         ASSERT_TRUE(produced == expected);
     }
 
+    TEST(ProofTheory, RuleTemplate) {
+        ltsy::BisonFmlaParser parser;
+        auto p = parser.parse("p");
+        auto q = parser.parse("q");
+        ltsy::MultipleConclusionRule rule
+            {"con_i", ltsy::NdSequent<std::set>({{p, q},{parser.parse("p and (q or r)")}}), {{0,1}}}; 
+        ltsy::MultipleConclusionRuleTemplate tmpl {rule};
+        ltsy::FormulaVarAssignment ass {std::map<ltsy::Prop, std::shared_ptr<ltsy::Formula>>{
+            {*std::static_pointer_cast<ltsy::Prop>(p), parser.parse("neg q")},
+            {*std::static_pointer_cast<ltsy::Prop>(q), parser.parse("p")}}};
+        auto expected = rule.apply_substitution(ass);
+        ASSERT_TRUE(tmpl.instantiate(ass).sequent() == expected.sequent());
+        auto factory = std::make_shared<ltsy::FormulaFactory>();
+        ASSERT_TRUE(tmpl.instantiate(std::vector<ltsy::FormulaVarAssignment>{ass}, factory)[0].sequent() == expected.sequent());
+        // every instance formula was interned above
+        ltsy::MultipleConclusionRuleTemplate::Nodes nodes;
+        ASSERT_TRUE(tmpl.resolve(ass, *factory, nodes));
+        auto resolved = tmpl.instantiate(nodes, ass);
+        auto resolved_sequent = resolved.sequent();
+        ASSERT_TRUE(resolved_sequent == expected.sequent());
+        for (const auto& f : resolved_sequent.at(1))
+            ASSERT_TRUE(factory->owns(*f));
+        // a new instance is not found, and nothing is created
+        ltsy::FormulaVarAssignment other {std::map<ltsy::Prop, std::shared_ptr<ltsy::Formula>>{
+            {*std::static_pointer_cast<ltsy::Prop>(p), parser.parse("q and q")}}};
+        auto size = factory->size();
+        ASSERT_FALSE(tmpl.resolve(other, *factory, nodes));
+        ASSERT_EQ(factory->size(), size);
+    }
+
     TEST(ProofTheory, MultipleConclusionCalculusDerivableSimple) {
         ltsy::BisonFmlaParser parser;
         auto p = parser.parse("p");
@@ -0,0 +1,211 @@
+#include "gtest/gtest.h"
+#include "core/parser/fmla/fmla_parser.h"
+#include "core/serialization/binary.h"
+#include <cstdio>
+
+namespace {
+
+    TEST(BinarySerialization, RoundTrip) {
+        ltsy::BisonFmlaParser parser;
+        auto p = parser.parse("p");
+        auto p_and_q = parser.parse("p and q");
+        auto neg_p_and_q = parser.parse("neg (p and q)");
+        ltsy::binary::BinaryWriter writer;
+        {
+            // formulas, sharing subformulas after reading
+            auto bytes = writer.write(ltsy::FmlaSet {p, p_and_q, neg_p_and_q});
+            ltsy::binary::BinaryReader reader {bytes.data(), bytes.size()};
+            ASSERT_EQ(reader.kind(), ltsy::binary::Kind::FMLA_SET);
+            auto fmlas = reader.read_fmla_set();
+            ASSERT_TRUE(fmlas == (ltsy::FmlaSet {p, p_and_q, neg_p_and_q}));
+            auto read_p_and_q = *fmlas.find(p_and_q);
+            auto read_neg = std::static_pointer_cast<ltsy::Compound>(*fmlas.find(neg_p_and_q));
+            ASSERT_EQ(read_neg->components()[0], read_p_and_q);
+            ASSERT_EQ(reader.factory()->size(), 4);
+            ASSERT_THROW(reader.read_truth_table(), ltsy::ParseException);
+        }
+        {
+            auto tt = ltsy::NDTruthTable(3, 2, std::vector<std::set<int>>{
+                    {0}, {1}, {0,2}, {}, {1,2}, {2}, {0,1,2}, {1}, {0}}, p_and_q);
+            tt.set_name("and");
+            tt.set_values_names({{0, "f"}, {1, "u"}, {2, "t"}});
+            auto bytes = writer.write(tt);
+            auto read = ltsy::binary::BinaryReader {bytes.data(), bytes.size()}.read_truth_table();
+            ASSERT_TRUE(read == tt);
+            ASSERT_EQ(read.name(), "and");
+            ASSERT_EQ(read.get_values_names(), tt.get_values_names());
+            ASSERT_TRUE(ltsy::utils::DeepSharedPointerComp<ltsy::Formula>{}(read.fmla(), p_and_q) == false);
+            // truncated data
+            ASSERT_THROW((ltsy::binary::BinaryReader {bytes.data(), bytes.size() - 1}.read_truth_table()),
+                    ltsy::ParseException);
+        }
+        {
+            auto sig = std::make_shared<ltsy::Signature>(ltsy::Signature {{"neg", 1}, {"and", 2}});
+            auto interp = std::make_shared<ltsy::SignatureTruthInterp<std::set<int>>>(sig);
+            interp->try_interpret(std::make_shared<ltsy::TruthInterp<std::set<int>>>((*sig)["neg"],
+                    std::make_shared<ltsy::NDTruthTable>(2, 1, std::vector<std::set<int>>{{1}, {0,1}})));
+            interp->try_interpret(std::make_shared<ltsy::TruthInterp<std::set<int>>>((*sig)["and"],
+                    std::make_shared<ltsy::NDTruthTable>(2, 2, std::vector<std::set<int>>{{0}, {0}, {0}, {1}})));
+            ltsy::GenMatrix matrix {{0, 1}, {{1}}, sig, interp};
+            matrix.set_val_to_str({{0, "f"}, {1, "t"}});
+            auto bytes = writer.write(matrix);
+            // through a memory-mapped file
+            auto path = testing::TempDir() + "ltsy_matrix.bin";
+            ltsy::binary::BinaryWriter::write_file(path, bytes);
+            std::shared_ptr<ltsy::GenMatrix> read;
+            {
+                ltsy::binary::MappedFile file {path};
+                read = ltsy::binary::BinaryReader {file.data(), file.size()}.read_gen_matrix();
+            }
+            std::remove(path.c_str());
+            ASSERT_EQ(read->values(), matrix.values());
+            ASSERT_EQ(read->distinguished_sets(), matrix.distinguished_sets());
+            ASSERT_EQ(read->str_to_val().at("t"), 1);
+            ASSERT_TRUE(*read->interpretation()->get_interpretation("neg")->truth_table()
+                    == *interp->get_interpretation("neg")->truth_table());
+            ASSERT_TRUE(*read->interpretation()->get_interpretation("and")->truth_table()
+                    == *interp->get_interpretation("and")->truth_table());
+        }
+        {
+            ltsy::MultipleConclusionRule rule {"r1", ltsy::NdSequent<std::set>({{p, p_and_q}, {neg_p_and_q}}), {{0,1}}};
+            rule.set_group("and");
+            auto bytes = writer.write(ltsy::MultipleConclusionCalculus {{rule}});
+            auto read = ltsy::binary::BinaryReader {bytes.data(), bytes.size()}.read_calculus();
+            ASSERT_EQ(read.size(), 1);
+            auto read_rule = read.rules()[0];
+            ASSERT_FALSE(read_rule < rule or rule < read_rule);
+            ASSERT_EQ(read_rule.name(), "r1");
+            ASSERT_EQ(read_rule.group(), "and");
+            ASSERT_EQ(read_rule.prem_conc_pos_corresp(), rule.prem_conc_pos_corresp());
+        }
+    }
+
+    /* Little-endian bytes of an artifact without formulas,
+     * whose body is given as 32-bit and 64-bit words.
+     * */
+    std::string artifact_bytes(ltsy::binary::Kind kind, std::vector<std::uint64_t> words, 
+            std::vector<bool> wide = {}) {
+        std::string bytes;
+        auto put = [&](std::uint64_t v, int n) {
+            for (int i = 0; i < n; ++i)
+                bytes.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+        };
+        put(ltsy::binary::MAGIC, 4);
+        put(ltsy::binary::VERSION, 2);
+        put(static_cast<std::uint16_t>(kind), 2);
+        put(0, 4); put(0, 4); put(0, 4); // no variables, connectives or nodes
+        for (std::size_t i = 0; i < words.size(); ++i)
+            put(words[i], i < wide.size() and wide[i] ? 8 : 4);
+        return bytes;
+    }
+
+    TEST(BinarySerialization, MalformedInput) {
+        using ltsy::binary::Kind;
+        using ltsy::binary::NO_FORMULA;
+        auto read_table = [](const std::string& bytes) {
+            return ltsy::binary::BinaryReader {bytes.data(), bytes.size()}.read_truth_table();
+        };
+        // nvalues, arity, name length, formula, number of value names, rows
+        auto table = artifact_bytes(Kind::TRUTH_TABLE, {2, 1, 0, NO_FORMULA, 0, 0b01, 0b11}, 
+                {false, false, false, false, false, true, true});
+        ASSERT_EQ(read_table(table).number_of_rows(), 2);
+        // huge arity, without the rows to back it
+        ASSERT_THROW(read_table(artifact_bytes(Kind::TRUTH_TABLE, {2, 40, 0, NO_FORMULA, 0})), ltsy::ParseException);
+        ASSERT_THROW(read_table(artifact_bytes(Kind::TRUTH_TABLE, {2, 26, 0, NO_FORMULA, 0, 0, 0}, 
+                        {false, false, false, false, false, true, true})), ltsy::ParseException);
+        ASSERT_THROW(read_table(artifact_bytes(Kind::TRUTH_TABLE, {1, 0xFFFFFFFF, 0, NO_FORMULA, 0})), 
+                ltsy::ParseException);
+        // numbers of values out of range
+        ASSERT_THROW(read_table(artifact_bytes(Kind::TRUTH_TABLE, {0, 1, 0, NO_FORMULA, 0})), ltsy::ParseException);
+        ASSERT_THROW(read_table(artifact_bytes(Kind::TRUTH_TABLE, {65, 1, 0, NO_FORMULA, 0})), ltsy::ParseException);
+        // image with a value out of range
+        ASSERT_THROW(read_table(artifact_bytes(Kind::TRUTH_TABLE, {2, 1, 0, NO_FORMULA, 0, 0b01, 0b100},
+                        {false, false, false, false, false, true, true})), ltsy::ParseException);
+        auto read_calculus = [](const std::string& bytes) {
+            return ltsy::binary::BinaryReader {bytes.data(), bytes.size()}.read_calculus();
+        };
+        // one rule: name length, group length, dimension, sets, correspondence
+        ASSERT_EQ(read_calculus(artifact_bytes(Kind::CALCULUS, {1, 0, 0, 2, 0, 0, 1, 0, 1})).size(), 1);
+        ASSERT_THROW(read_calculus(artifact_bytes(Kind::CALCULUS, {1, 0, 0, 0xFFFFFFFF})), ltsy::ParseException);
+        ASSERT_THROW(read_calculus(artifact_bytes(Kind::CALCULUS, {1, 0, 0, 2, 0, 0, 1, 0xFFFFFFFF, 1})), 
+                ltsy::ParseException);
+        ASSERT_THROW(read_calculus(artifact_bytes(Kind::CALCULUS, {1, 0, 0, 2, 0, 0, 1, 0, 2})), 
+                ltsy::ParseException);
+    }
+
+    TEST(BinarySerialization, MalformedFormulas) {
+        ltsy::BisonFmlaParser parser;
+        auto p = parser.parse("p");
+        auto p_and_q = parser.parse("p and q");
+        ltsy::binary::BinaryWriter writer;
+        auto read_set = [](const std::string& bytes) {
+            return ltsy::binary::BinaryReader {bytes.data(), bytes.size()}.read_fmla_set();
+        };
+        auto set_u32 = [](std::string& bytes, std::size_t offset, std::uint32_t v) {
+            for (int i = 0; i < 4; ++i)
+                bytes[offset + i] = static_cast<char>((v >> (8 * i)) & 0xFF);
+        };
+        // absent formula inside a set
+        auto bytes = writer.write(ltsy::FmlaSet {p, p_and_q});
+        ASSERT_EQ(read_set(bytes).size(), 2);
+        set_u32(bytes, bytes.size() - 4, ltsy::binary::NO_FORMULA);
+        ASSERT_THROW(read_set(bytes), ltsy::ParseException);
+        // unknown node type: header, one variable "p", no connectives, one node
+        bytes = writer.write(ltsy::FmlaSet {p});
+        const std::size_t type_offset = 8 + 4 + 5 + 4 + 4;
+        ASSERT_EQ(bytes[type_offset], 0);
+        bytes[type_offset] = 2;
+        ASSERT_THROW(read_set(bytes), ltsy::ParseException);
+        // huge connective arities, without the children to back them
+        auto connective_bytes = [](std::uint32_t arity) {
+            std::string bytes;
+            auto put = [&](std::uint64_t v, int n) {
+                for (int i = 0; i < n; ++i)
+                    bytes.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+            };
+            put(ltsy::binary::MAGIC, 4);
+            put(ltsy::binary::VERSION, 2);
+            put(static_cast<std::uint16_t>(ltsy::binary::Kind::FMLA_SET), 2);
+            put(0, 4);
+            put(1, 4); put(1, 4); bytes.push_back('c'); put(arity, 4);
+            put(1, 4); put(1, 1); put(0, 4); put(arity, 4);
+            return bytes;
+        };
+        ASSERT_THROW(read_set(connective_bytes(0x7FFFFFFF)), ltsy::ParseException);
+        ASSERT_THROW(read_set(connective_bytes(0x80000000)), ltsy::ParseException);
+    }
+
+    TEST(BinarySerialization, MalformedMatrix) {
+        auto sig = std::make_shared<ltsy::Signature>(ltsy::Signature {{"neg", 1}});
+        auto interp = std::make_shared<ltsy::SignatureTruthInterp<std::set<int>>>(sig);
+        interp->try_interpret(std::make_shared<ltsy::TruthInterp<std::set<int>>>((*sig)["neg"],
+                std::make_shared<ltsy::NDTruthTable>(2, 1, std::vector<std::set<int>>{{1}, {0,1}})));
+        ltsy::GenMatrix matrix {{0, 1}, {{1}}, sig, interp};
+        ltsy::binary::BinaryWriter writer;
+        auto bytes = writer.write(matrix);
+        auto read_matrix = [](const std::string& bytes) {
+            return ltsy::binary::BinaryReader {bytes.data(), bytes.size()}.read_gen_matrix();
+        };
+        ASSERT_EQ(read_matrix(bytes)->values().size(), 2);
+        // the symbol of the interpretation comes after that of the signature
+        auto symbol_offset = bytes.rfind("neg");
+        {
+            auto unknown = bytes;
+            unknown[symbol_offset + 1] = 'o';
+            ASSERT_THROW(read_matrix(unknown), ltsy::ParseException);
+        }
+        {
+            // the number of values of the table follows its symbol
+            auto mismatched = bytes;
+            mismatched[symbol_offset + 3] = 3;
+            ASSERT_THROW(read_matrix(mismatched), ltsy::ParseException);
+        }
+        {
+            // the first value, after the number of values
+            auto out_of_range = bytes;
+            out_of_range[8 + 4 + 4 + 4 + 4] = 64;
+            ASSERT_THROW(read_matrix(out_of_range), ltsy::ParseException);
+        }
+    }
+
+};
@@ -59,6 +59,25 @@ namespace {
         std::cout << (*subsfmla) << std::endl;
     }
 
+    TEST(Formula, SubstitutionSharing) {
+        ltsy::BisonFmlaParser parser;
+        auto fmla = parser.parse("(q or r) and p");
+        auto other = parser.parse("neg p");
+        ltsy::FormulaVarAssignment ass {{{ltsy::Prop("p"), parser.parse("neg s")}}};
+        ltsy::SubstitutionEvaluator subs {ass};
+        auto subsfmla = std::static_pointer_cast<ltsy::Compound>(fmla->accept(subs));
+        ASSERT_TRUE(*subsfmla == *parser.parse("(q or r) and (neg s)"));
+        // the unaffected subtree is not rebuilt
+        auto original = std::static_pointer_cast<ltsy::Compound>(fmla);
+        ASSERT_EQ(subsfmla->components()[0].get(), original->components()[0].get());
+        // results are memoized by node within the evaluator
+        ASSERT_EQ(fmla->accept(subs).get(), subsfmla.get());
+        ASSERT_TRUE(*other->accept(subs) == *parser.parse("neg neg s"));
+        // formulas without assigned variables are returned as they are
+        auto closed = parser.parse("q or r");
+        ASSERT_EQ(closed->accept(subs).get(), closed.get());
+    }
+
     TEST(Formula, PropSetComparison) {
         auto p1 = std::make_shared<ltsy::Prop>("p");
         auto q1 = std::make_shared<ltsy::Prop>("q");
@@ -80,6 +99,26 @@ namespace {
         }
     }
 
+    TEST(Formula, Metadata) {
+        ltsy::BisonFmlaParser parser;
+        auto fmla = parser.parse("p and (q or p)");
+        const auto& meta = fmla->metadata();
+        ASSERT_EQ(&meta, &fmla->metadata());
+        ASSERT_EQ(fmla->depth(), 2);
+        ASSERT_TRUE(fmla->has_variable(ltsy::Prop("q").symbol_id()));
+        ASSERT_FALSE(fmla->has_variable(ltsy::Prop("r").symbol_id()));
+        // p, q and q or p, each once
+        auto subformulas = fmla->subformulas();
+        ASSERT_EQ(subformulas.size(), 3);
+        ASSERT_EQ(*subformulas.back(), *parser.parse("q or p"));
+        // collected subformulas share the nodes of the formula
+        ltsy::SubFormulaCollector subs;
+        fmla->accept(subs);
+        ASSERT_EQ(subs.subfmlas().size(), 4);
+        ASSERT_TRUE(subs.subfmlas().find(fmla) != subs.subfmlas().end());
+        ASSERT_EQ(subs.subfmlas().find(fmla)->get(), fmla.get());
+    }
+
     TEST(Formula, CollectVariables) {
         auto p = std::make_shared<ltsy::Prop>("p");
         auto q = std::make_shared<ltsy::Prop>("q");
@@ -104,6 +143,24 @@ namespace {
         ASSERT_EQ(sig_collector.get_collected_signature(), expected);
     }
 
+    TEST(Signature, SymbolIds) {
+        auto& table = ltsy::SymbolTable::connectives();
+        auto id = table.id("&");
+        ASSERT_EQ(table.id("&"), id);
+        ASSERT_EQ(table.symbol(id), "&");
+        ltsy::Signature sig {{"&", 2}, {"~", 1}};
+        ASSERT_EQ(sig.by_id(id)->symbol(), "&");
+        ASSERT_EQ(sig["~"]->symbol_id(), table.id("~"));
+        ASSERT_THROW(sig.by_id(table.id("symbol-ids-absent")), ltsy::ConnectiveNotPresentException);
+        ltsy::Prop p {"p"}, other_p {"p"};
+        ASSERT_EQ(p.symbol_id(), other_p.symbol_id());
+        ASSERT_EQ(ltsy::SymbolTable::variables().symbol(p.symbol_id()), "p");
+        ltsy::FormulaVarAssignment ass {{{p, std::make_shared<ltsy::Prop>("q")}}};
+        ASSERT_EQ(ass.size(), 1);
+        ASSERT_TRUE(*ass(p.symbol_id()) == ltsy::Prop("q"));
+        ASSERT_EQ(ass(ltsy::Prop("r")), nullptr);
+    }
+
     TEST(Signature, Specification) {
         ltsy::Signature cl_sig {
             {"&", 2},
@@ -193,4 +250,69 @@ namespace {
             std::cout << *f << std::endl;
     }
 
+    TEST(Formula, HashConsing) {
+        ltsy::BisonFmlaParser parser;
+        auto factory = std::make_shared<ltsy::FormulaFactory>();
+        auto fmla1 = factory->intern(parser.parse("p and (q or p)"));
+        auto fmla2 = factory->intern(parser.parse("p and (q or p)"));
+        auto fmla3 = factory->intern(parser.parse("p and (r or p)"));
+        ASSERT_EQ(fmla1.get(), fmla2.get());
+        ASSERT_NE(fmla1->id(), fmla3->id());
+        ASSERT_TRUE(*fmla1 == *fmla2);
+        ASSERT_FALSE(*fmla1 == *fmla3);
+        // p, q, r, q or p, r or p, and the two conjunctions
+        ASSERT_EQ(factory->size(), 7);
+        // interned and non-interned formulas keep the structural order
+        auto plain = parser.parse("p and (r or p)");
+        ASSERT_TRUE(*fmla3 == *plain);
+        ASSERT_EQ(*fmla1 < *fmla3, *parser.parse("p and (q or p)") < *plain);
+        // substitution builds interned formulas
+        ltsy::FormulaVarAssignment ass {{{ltsy::Prop("p"), factory->make_prop("q")}}};
+        ltsy::SubstitutionEvaluator subs {ass, factory};
+        auto subsfmla = parser.parse("neg p")->accept(subs);
+        ASSERT_TRUE(factory->owns(*subsfmla));
+        ASSERT_EQ(subsfmla.get(), factory->intern(parser.parse("neg q")).get());
+    }
+
+    TEST(Formula, FmlaHashSet) {
+        ltsy::BisonFmlaParser parser;
+        auto fmla1 = parser.parse("p and (q or p)");
+        auto fmla2 = parser.parse("p or r");
+        auto fmla3 = parser.parse("neg t");
+        ASSERT_EQ(fmla1->hash(), parser.parse("p and (q or p)")->hash());
+        ltsy::FmlaHashSet f1 {fmla1, fmla2};
+        ltsy::FmlaHashSet f2 {parser.parse("p or r"), fmla3};
+        auto inters = ltsy::intersection(f1, f2);
+        ASSERT_EQ(inters.size(), 1);
+        ASSERT_TRUE(**inters.begin() == *fmla2);
+        auto diff = ltsy::difference(f1, f2);
+        ASSERT_EQ(diff.size(), 1);
+        ASSERT_TRUE(**diff.begin() == *fmla1);
+        ASSERT_TRUE(ltsy::is_subset(inters, f1));
+        ASSERT_FALSE(ltsy::is_subset(f1, f2));
+        ltsy::FmlaSet ordered {parser.parse("p or r")};
+        ASSERT_TRUE(ltsy::is_subset(ordered, f2));
+        ASSERT_EQ(ltsy::intersection(ordered, f1).size(), 1);
+        ASSERT_EQ(ltsy::difference(ordered, f1).size(), 0);
+    }
+
+    TEST(Formula, FormulaPool) {
+        ltsy::BisonFmlaParser parser;
+        auto fmla1 = parser.parse("p and (q or p)");
+        auto fmla2 = parser.parse("neg (q or p)");
+        ltsy::FormulaPool pool;
+        auto i1 = pool.add(fmla1);
+        auto i2 = pool.add(fmla2);
+        // p, q, q or p, the conjunction and the negation
+        ASSERT_EQ(pool.size(), 5);
+        ASSERT_EQ(pool.add(parser.parse("q or p")), pool.child(i2, 0));
+        ASSERT_EQ(pool.variables().size(), 2);
+        ASSERT_EQ(pool.connectives().size(), 3);
+        for (std::size_t i = 0; i < pool.size(); ++i)
+            for (std::size_t k = 0; k < pool.node(i).arity; ++k)
+                ASSERT_LT(pool.child(i, k), i);
+        ASSERT_TRUE(*pool.formula(i1) == *fmla1);
+        ASSERT_TRUE(*pool.formula(i2) == *fmla2);
+    }
+
 };
@@ -43,6 +43,28 @@ namespace {
         //    std::cout << d << std::endl;
     }
 
+    TEST(Determinants, LazyRange) {
+        auto tt = ltsy::TruthTable<std::set<int>> {3,
+            {
+                {{0, 0},{0, 1}}, {{0, 1},{2}}, {{0, 2},{}},
+                {{1, 0},{1}}, {{1, 1},{0, 2}}, {{1, 2},{1}},
+                {{2, 0},{0}}, {{2, 1},{}}, {{2, 2},{2}},
+            }
+        };
+        tt.set_values_names({{0, "f"}, {1, "b"}, {2, "t"}});
+        auto dets = tt.get_determinants();
+        ASSERT_EQ(tt.determinants().size(), dets.size());
+        auto it = dets.begin();
+        for (const auto& d : tt.determinants()) {
+            ASSERT_EQ(d.get_args(), it->get_args());
+            ASSERT_EQ(d.get_last(), it->get_last());
+            ASSERT_TRUE(d.to_determinant() == *it);
+            ASSERT_EQ(d.get_value_name(2), "t");
+            ++it;
+        }
+        ASSERT_TRUE(it == dets.end());
+    }
+
     TEST(TruthTable, NondeterministicTT) {
         auto tt_nondet = ltsy::TruthTable<std::set<int>> {2,
             {
@@ -103,6 +125,109 @@ namespace {
        std::cout << comp_not_not.print().str() << std::endl;
     }
 
+    TEST(TruthTable, ValueMaskCells) {
+       ltsy::ValueMask mask {std::set<int>{0, 3, 5}};
+       ASSERT_EQ(mask.size(), 3);
+       ASSERT_EQ(mask.to_set(), (std::set<int>{0, 3, 5}));
+       ASSERT_TRUE(ltsy::ValueMask::singleton(3).is_subset_of(mask));
+       ASSERT_EQ((mask - ltsy::ValueMask::all(4)).to_set(), std::set<int>{5});
+       ASSERT_THROW(ltsy::ValueMask::singleton(64), std::invalid_argument);
+       auto tt_f = ltsy::TruthTable<std::set<int>>(3, 
+               {
+                   {{0,0},{0}}, {{0,1},{1}}, {{0,2},{}},
+                   {{1,0},{1}}, {{1,1},{0}}, {{1,2},{2}},
+                   {{2,0},{}},  {{2,1},{2}}, {{2,2},{1,2}},
+       });
+       ltsy::NDMaskTruthTable masked {tt_f};
+       ASSERT_TRUE(masked.to_set_table() == tt_f);
+       ASSERT_EQ(masked.image({ltsy::ValueMask{std::set<int>{0,1}}, ltsy::ValueMask::singleton(1)}).to_set(),
+               (std::set<int>{0, 1}));
+       ASSERT_EQ(tt_f.image({ltsy::ValueMask::singleton(2), ltsy::ValueMask::all(3)}).to_set(),
+               (std::set<int>{1, 2}));
+       ASSERT_TRUE(masked.is_sub_table_total(ltsy::ValueMask{std::set<int>{0,1}}));
+       ASSERT_FALSE(tt_f.is_sub_table_total({0,2}));
+       ASSERT_EQ(tt_f.partial_inputs(), (std::set<std::set<int>>{{0,2}}));
+       auto [dets, empty_dets] = tt_f.get_sub_table_determinants({1,2});
+       ASSERT_EQ(dets.size(), 4);
+       ASSERT_EQ(empty_dets.size(), 1);
+       // components with equal images take equal values: f(g,g) at
+       // a row where g gives {0,1} only looks at f(0,0) and f(1,1)
+       auto tt_g = ltsy::TruthTable<std::set<int>>(3, 
+               {{{0},{0,1}}, {{1},{0,1}}, {{2},{2}}});
+       auto comp = tt_f.compose({tt_g, tt_g});
+       ASSERT_EQ(comp.at(0), std::set<int>{0});
+       ASSERT_EQ(comp.at(2), (std::set<int>{1, 2}));
+       ASSERT_TRUE(masked.compose({ltsy::NDMaskTruthTable{tt_g}, ltsy::NDMaskTruthTable{tt_g}}).to_set_table() == comp);
+    }
+
+    TEST(TruthTable, ComposeKernel) {
+       ltsy::BisonFmlaParser parser;
+       auto tt_f = ltsy::TruthTable<std::set<int>>(3, 
+               {
+                   {{0,0},{0}}, {{0,1},{1}}, {{0,2},{2}},
+                   {{1,0},{1}}, {{1,1},{}}, {{1,2},{0,2}},
+                   {{2,0},{2}}, {{2,1},{0}}, {{2,2},{1}}
+       }, parser.parse("p and q"));
+       auto tt_g = ltsy::TruthTable<std::set<int>>(3, 
+               {
+                   {{0},{0,1}}, {{1},{1,2}}, {{2},{}}
+       }, parser.parse("neg p"));
+       auto tt_h = ltsy::TruthTable<std::set<int>>(3, 
+               {
+                   {{0},{0,1}}, {{1},{2}}, {{2},{0,1,2}}
+       }, parser.parse("neg p"));
+       ltsy::NDMaskTableComposer composer;
+       ltsy::NDMaskTruthTable masked_f {tt_f};
+       for (const auto& gs : std::vector<std::vector<ltsy::NDTruthTable>> 
+               {{tt_g, tt_g}, {tt_g, tt_h}, {tt_h, tt_g}, {tt_h, tt_h}}) {
+           auto comp = composer.compose(masked_f, {ltsy::NDMaskTruthTable{gs[0]}, ltsy::NDMaskTruthTable{gs[1]}});
+           for (int row = 0; row < 3; ++row) {
+               // the image by brute force: arguments with the
+               // same image at the row must take the same value
+               std::set<int> expected;
+               auto x = gs[0].at(row), y = gs[1].at(row);
+               for (auto a : x)
+                   for (auto b : y)
+                       if (x != y or a == b)
+                           for (auto v : tt_f.at(a * 3 + b))
+                               expected.insert(v);
+               ASSERT_EQ(comp.at(row).to_set(), expected);
+           }
+           ASSERT_TRUE(comp.fmla() != nullptr);
+       }
+       ASSERT_THROW(composer.compose(masked_f, {ltsy::NDMaskTruthTable{tt_g}}), std::invalid_argument);
+    }
+
+    TEST(TruthTable, HashAndStore) {
+       auto tt_or = ltsy::TruthTable<std::set<int>>(2, 
+               {
+                   {{0,0},{0}}, {{0,1},{1}},
+                   {{1,0},{1}}, {{1,1},{0,1}}
+       });
+       auto tt_and = ltsy::TruthTable<std::set<int>>(2, 
+               {
+                   {{0,0},{0}}, {{0,1},{0}},
+                   {{1,0},{0}}, {{1,1},{1}}
+       });
+       auto tt = tt_and;
+       ASSERT_EQ(std::hash<ltsy::NDTruthTable>{}(tt), tt_and.hash());
+       // the cached hash follows the changes of the images
+       tt.set(1, {1});
+       tt.set(2, {1});
+       tt.set(3, {0,1});
+       ASSERT_EQ(tt.hash(), ltsy::NDTruthTable{tt_or}.hash());
+       ASSERT_TRUE(tt == tt_or);
+       ASSERT_TRUE(tt != tt_and);
+       ltsy::TruthTableStore<std::set<int>> store;
+       ASSERT_TRUE(store.insert(tt_or));
+       ASSERT_TRUE(store.insert(tt_and));
+       ASSERT_FALSE(store.insert(tt));
+       ASSERT_EQ(store.size(), 2);
+       ASSERT_EQ(store.find(tt_and), 1);
+       ASSERT_TRUE(store == (ltsy::TruthTableStore<std::set<int>> {std::vector<ltsy::NDTruthTable>{tt_and, tt_or}}));
+       ASSERT_TRUE(store != (ltsy::TruthTableStore<std::set<int>> {std::vector<ltsy::NDTruthTable>{tt_and}}));
+    }
+
     TEST(TruthTable, Compose) {
        ltsy::BisonFmlaParser parser;
        auto neg_p = parser.parse("neg p");
@@ -147,6 +272,35 @@ namespace {
         }
     }
 
+    TEST(TruthTable, TableGenRankAndRanges) {
+        ltsy::TruthTableGenerator ttgen {3, 1};
+        ASSERT_EQ(ttgen.quantity(), 27);
+        std::vector<ltsy::TruthTable<int>> all;
+        while (ttgen.has_next()) {
+            auto index = ttgen.current_index();
+            auto tt = ttgen.next();
+            ASSERT_EQ(ttgen.rank(*tt), index);
+            ASSERT_TRUE(ttgen.unrank(index) == *tt);
+            all.push_back(*tt);
+        }
+        std::vector<ltsy::TruthTable<int>> from_slices;
+        for (auto& slice : ttgen.split(4))
+            while (slice.has_next())
+                from_slices.push_back(*slice.next());
+        ASSERT_TRUE(from_slices == all);
+        ttgen.seek(20);
+        ASSERT_TRUE(*ttgen.next() == all[20]);
+        // 5^25 tables, beyond the range of int
+        ltsy::TruthTableGenerator large {5, 2, 298023223876953120ULL};
+        ASSERT_EQ(large.quantity(), 298023223876953125ULL);
+        int count = 0;
+        for (; large.has_next(); ++count)
+            large.next();
+        ASSERT_EQ(count, 5);
+        ASSERT_EQ(large.current()->at(24), 4);
+        ASSERT_THROW((ltsy::TruthTableGenerator {4, 3}), std::overflow_error);
+    }
+
     TEST(TruthTable, NullaryTableGen) {
         ltsy::TruthTableGenerator ttgen {2, 0};
         while (ttgen.has_next()) {